@@ -29,7 +29,6 @@
 #include <TView3D.h>
 #include <TPolyLine3D.h>
 #include <TPolyMarker3D.h>
-#include <TRandom3.h>
 #include <TStyle.h>
 #include <TAxis.h>
 #include <TGaxis.h>
@@ -39,6 +38,8 @@
 #include <TVirtualFFT.h>
 #include <TSystem.h>
 
+#include "WCPTiling/ParallelFor.h"
+
 using namespace std;
 
 const Double_t heightToWidthRatio = 0.50;
@@ -64,6 +65,11 @@ Double_t angleU = 60.0;
 Double_t angleV = 60.0;
 Int_t numYwires = 10;
 Int_t plotMode = 0;
+ULong64_t chargeSeed = 0;
+Int_t numThreads = 1;
+string cellMapFile = "cellmap.bin";
+
+const Int_t chargeBlock = 4096; // cells given charge per task
 
 enum Plane_t {kUPlane, kVPlane, kYPlane};
 enum Hit_t {kNoHit, kRealHit, kFakeHit};
@@ -124,6 +130,7 @@ Int_t getVwireID(Double_t Yval, Double_t Zval);
 Double_t getYwireZval(Int_t IDnum);
 Int_t getYwireID(Double_t Zval);
 pair<pair<Double_t,Double_t>,pair<Double_t,Double_t> > getWireEndpoints(Int_t wireID, Plane_t wirePlane);
+Double_t cellUniform(ULong64_t seed, Int_t cellID);
 void addCharges(CellMap &cellMap);
 void assignHitTypes(CellMap &cellMap);
 void drawCellMap(CellMap const& cellMap, Int_t numWires, Int_t numCells);
@@ -134,6 +141,8 @@ ostream& operator<<(ostream& os, const WireVector& wire_plane);
 ostream& operator<<(ostream& os, const Cell& cell);
 ostream& operator<<(ostream& os, const vector<Cell>& cells);
 ostream& operator<<(ostream& os, const CellMap& cm);
+Bool_t writeCellMap(const CellMap& cm, const string& fileName);
+Bool_t readCellMap(const string& fileName, CellMap& cm);
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // main - Main function to run program
@@ -152,6 +161,22 @@ Int_t main(Int_t argc, Char_t** argv)
     numYwires = (Int_t) atoi(argv[3]);
   if(argc > 4)
     plotMode = (Int_t) atoi(argv[4]);
+  if(argc > 5)
+    chargeSeed = (ULong64_t) strtoull(argv[5],0,10);
+  if(argc > 6)
+    numThreads = (Int_t) atoi(argv[6]);
+  if(argc > 7)
+    cellMapFile = argv[7];
+
+  // plotMode -2 prints a cell map written by plotMode -1 as text
+  ios::sync_with_stdio(false);
+  if(plotMode == -2) {
+      CellMap savedCellMap;
+      if(!readCellMap(cellMapFile,savedCellMap))
+	  return 1;
+      cout << savedCellMap << endl;
+      return 0;
+  }
 
   // Adjust offsets for MicroBooNE case
   const Double_t maxHeight = heightToWidthRatio*wirePitchY*numYwires; 
@@ -169,6 +194,10 @@ Int_t main(Int_t argc, Char_t** argv)
   addCharges(globalCellMap);
   if(plotMode > 0)
     drawCellMap(globalCellMap,-1,-1);
+  else if(plotMode < 0) {
+      if(!writeCellMap(globalCellMap,cellMapFile))
+	  return 1;
+  }
   else {
       cout << globalCellMap << endl;
   }
@@ -191,7 +220,7 @@ ostream& operator<<(ostream& os, const WireVector& wire_plane)
 {
     for (size_t ind=0; ind < wire_plane.size(); ++ind) {
 	const Wire& w = wire_plane[ind];
-	os << w << endl;
+	os << w << '\n';
     }
     return os;
 }
@@ -207,7 +236,7 @@ ostream& operator<<(ostream& os, const vector<Cell>& cells)
     size_t ncells = cells.size();
     for (size_t ind=0; ind<ncells; ++ind) {
 	const Cell& cell = cells[ind];
-	os << cell << endl;
+	os << cell << '\n';
     }
     return os;
 }
@@ -217,6 +246,248 @@ ostream& operator<<(ostream& os, const CellMap& cm)
     return os;
 }
 
+// The binary cell map is a header followed by columns, each the
+// values of one field for every wire or cell, in native byte order.
+// The wires are those of the U, V and Y planes in turn.
+//
+//   wires:  ID, plane, location, charge (Int_t, Int_t, Double_t, Double_t)
+//           cellOffset (Long64_t, nwires+1), cellIDs (Int_t)
+//   cells:  ID, UwireID, VwireID, YwireID, hitType (Int_t)
+//           centerZ, centerY, area, trueCharge, recoCharge (Double_t)
+//           vertexOffset (Long64_t, ncells+1), vertexZ, vertexY (Double_t)
+//
+// The cells of wire i are cellIDs[cellOffset[i],cellOffset[i+1]) and
+// likewise the vertices of a cell.
+const UInt_t cellMapMagic = 0x4d434357; // "WCCM"
+const UInt_t cellMapVersion = 1;
+
+struct CellMapHeader
+{
+    UInt_t magic;
+    UInt_t version;
+    Long64_t numWires[3];
+    Long64_t numCells;
+    Long64_t numWireCells;
+    Long64_t numVertices;
+};
+
+template <class T>
+static void writeColumn(ostream& os, const vector<T>& column)
+{
+    if (!column.empty()) {
+	os.write((const char*)&column[0], column.size()*sizeof(T));
+    }
+}
+
+template <class T>
+static void readColumn(istream& is, vector<T>& column, Long64_t size)
+{
+    column.resize(size);
+    if (size > 0) {
+	is.read((char*)&column[0], size*sizeof(T));
+    }
+}
+
+// True if the offsets into a column of the given size start at zero,
+// never decrease and end at its size.
+static bool validOffsets(const vector<Long64_t>& offset, Long64_t size)
+{
+    if (offset.empty() || offset.front() != 0 || offset.back() != size) {
+	return false;
+    }
+    for (size_t ind = 1; ind < offset.size(); ++ind) {
+	if (offset[ind] < offset[ind-1]) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+Bool_t writeCellMap(const CellMap& cm, const string& fileName)
+{
+    const vector<Wire>* planes[3] = {&cm.Uwires, &cm.Vwires, &cm.Ywires};
+    CellMapHeader header = {cellMapMagic, cellMapVersion, {0, 0, 0}, (Long64_t)cm.cells.size(), 0, 0};
+
+    vector<Int_t> wireID, wirePlane, cellIDs;
+    vector<Double_t> wireLocation, wireCharge;
+    vector<Long64_t> cellOffset(1, 0);
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	header.numWires[iplane] = planes[iplane]->size();
+	for (size_t ind = 0; ind < planes[iplane]->size(); ++ind) {
+	    const Wire& wire = (*planes[iplane])[ind];
+	    wireID.push_back(wire.ID);
+	    wirePlane.push_back(wire.plane);
+	    wireLocation.push_back(wire.location);
+	    wireCharge.push_back(wire.charge);
+	    cellIDs.insert(cellIDs.end(), wire.cellIDs.begin(), wire.cellIDs.end());
+	    cellOffset.push_back(cellIDs.size());
+	}
+    }
+    header.numWireCells = cellIDs.size();
+
+    const size_t ncells = cm.cells.size();
+    vector<Int_t> cellID(ncells), UwireID(ncells), VwireID(ncells), YwireID(ncells), hitType(ncells);
+    vector<Double_t> centerZ(ncells), centerY(ncells), area(ncells), trueCharge(ncells), recoCharge(ncells);
+    vector<Long64_t> vertexOffset(1, 0);
+    vector<Double_t> vertexZ, vertexY;
+    for (size_t ind = 0; ind < ncells; ++ind) {
+	const Cell& cell = cm.cells[ind];
+	cellID[ind] = cell.ID;
+	UwireID[ind] = cell.UwireID;
+	VwireID[ind] = cell.VwireID;
+	YwireID[ind] = cell.YwireID;
+	hitType[ind] = cell.hitType;
+	centerZ[ind] = cell.center.first;
+	centerY[ind] = cell.center.second;
+	area[ind] = cell.area;
+	trueCharge[ind] = cell.trueCharge;
+	recoCharge[ind] = cell.recoCharge;
+	for (size_t vert = 0; vert < cell.vertices.size(); ++vert) {
+	    vertexZ.push_back(cell.vertices[vert].first);
+	    vertexY.push_back(cell.vertices[vert].second);
+	}
+	vertexOffset.push_back(vertexZ.size());
+    }
+    header.numVertices = vertexZ.size();
+
+    ofstream out(fileName.c_str(), ios::binary);
+    out.write((const char*)&header, sizeof(header));
+    writeColumn(out, wireID);
+    writeColumn(out, wirePlane);
+    writeColumn(out, wireLocation);
+    writeColumn(out, wireCharge);
+    writeColumn(out, cellOffset);
+    writeColumn(out, cellIDs);
+    writeColumn(out, cellID);
+    writeColumn(out, UwireID);
+    writeColumn(out, VwireID);
+    writeColumn(out, YwireID);
+    writeColumn(out, hitType);
+    writeColumn(out, centerZ);
+    writeColumn(out, centerY);
+    writeColumn(out, area);
+    writeColumn(out, trueCharge);
+    writeColumn(out, recoCharge);
+    writeColumn(out, vertexOffset);
+    writeColumn(out, vertexZ);
+    writeColumn(out, vertexY);
+    out.close();
+    if (!out) {
+	cerr << "CellMaker: failed to write " << fileName << endl;
+	return false;
+    }
+    return true;
+}
+
+Bool_t readCellMap(const string& fileName, CellMap& cm)
+{
+    ifstream in(fileName.c_str(), ios::binary);
+    CellMapHeader header;
+    if (!in.read((char*)&header, sizeof(header))
+	|| header.magic != cellMapMagic || header.version != cellMapVersion) {
+	cerr << "CellMaker: " << fileName << " is not a binary cell map" << endl;
+	return false;
+    }
+
+    // The counts must be those of the columns the file holds before
+    // any column is sized by them.  No count exceeds the file size,
+    // so the size they give cannot overflow.
+    in.seekg(0, ios::end);
+    const Long64_t fileSize = in.tellg();
+    in.seekg(sizeof(header), ios::beg);
+    const Long64_t counts[6] = {header.numWires[0], header.numWires[1], header.numWires[2],
+				header.numCells, header.numWireCells, header.numVertices};
+    for (int ind = 0; ind < 6; ++ind) {
+	if (counts[ind] < 0 || counts[ind] > fileSize) {
+	    cerr << "CellMaker: " << fileName << " has a bad header" << endl;
+	    return false;
+	}
+    }
+    const Long64_t wireBytes = 2*sizeof(Int_t) + 2*sizeof(Double_t);
+    const Long64_t cellBytes = 5*sizeof(Int_t) + 5*sizeof(Double_t);
+    const Long64_t expectedSize = sizeof(header)
+	+ (header.numWires[0] + header.numWires[1] + header.numWires[2])*wireBytes
+	+ (header.numWires[0] + header.numWires[1] + header.numWires[2] + 1)*sizeof(Long64_t)
+	+ header.numWireCells*sizeof(Int_t)
+	+ header.numCells*cellBytes + (header.numCells + 1)*sizeof(Long64_t)
+	+ header.numVertices*2*sizeof(Double_t);
+    if (!in || expectedSize != fileSize) {
+	cerr << "CellMaker: " << fileName << " is truncated" << endl;
+	return false;
+    }
+
+    const Long64_t nwires = header.numWires[0] + header.numWires[1] + header.numWires[2];
+    vector<Int_t> wireID, wirePlane, cellIDs;
+    vector<Double_t> wireLocation, wireCharge;
+    vector<Long64_t> cellOffset;
+    readColumn(in, wireID, nwires);
+    readColumn(in, wirePlane, nwires);
+    readColumn(in, wireLocation, nwires);
+    readColumn(in, wireCharge, nwires);
+    readColumn(in, cellOffset, nwires+1);
+    readColumn(in, cellIDs, header.numWireCells);
+
+    const Long64_t ncells = header.numCells;
+    vector<Int_t> cellID, UwireID, VwireID, YwireID, hitType;
+    vector<Double_t> centerZ, centerY, area, trueCharge, recoCharge;
+    vector<Long64_t> vertexOffset;
+    vector<Double_t> vertexZ, vertexY;
+    readColumn(in, cellID, ncells);
+    readColumn(in, UwireID, ncells);
+    readColumn(in, VwireID, ncells);
+    readColumn(in, YwireID, ncells);
+    readColumn(in, hitType, ncells);
+    readColumn(in, centerZ, ncells);
+    readColumn(in, centerY, ncells);
+    readColumn(in, area, ncells);
+    readColumn(in, trueCharge, ncells);
+    readColumn(in, recoCharge, ncells);
+    readColumn(in, vertexOffset, ncells+1);
+    readColumn(in, vertexZ, header.numVertices);
+    readColumn(in, vertexY, header.numVertices);
+    if (!in) {
+	cerr << "CellMaker: " << fileName << " is truncated" << endl;
+	return false;
+    }
+    if (!validOffsets(cellOffset, header.numWireCells) || !validOffsets(vertexOffset, header.numVertices)) {
+	cerr << "CellMaker: " << fileName << " has bad offsets" << endl;
+	return false;
+    }
+
+    vector<Wire>* planes[3] = {&cm.Uwires, &cm.Vwires, &cm.Ywires};
+    Long64_t wire = 0;
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	planes[iplane]->resize(header.numWires[iplane]);
+	for (Long64_t ind = 0; ind < header.numWires[iplane]; ++ind, ++wire) {
+	    Wire& w = (*planes[iplane])[ind];
+	    w.ID = wireID[wire];
+	    w.plane = (Plane_t)wirePlane[wire];
+	    w.location = wireLocation[wire];
+	    w.charge = wireCharge[wire];
+	    w.cellIDs.assign(cellIDs.begin()+cellOffset[wire], cellIDs.begin()+cellOffset[wire+1]);
+	}
+    }
+
+    cm.cells.resize(ncells);
+    for (Long64_t ind = 0; ind < ncells; ++ind) {
+	Cell& cell = cm.cells[ind];
+	cell.ID = cellID[ind];
+	cell.UwireID = UwireID[ind];
+	cell.VwireID = VwireID[ind];
+	cell.YwireID = YwireID[ind];
+	cell.hitType = (Hit_t)hitType[ind];
+	cell.center = make_pair(centerZ[ind], centerY[ind]);
+	cell.area = area[ind];
+	cell.trueCharge = trueCharge[ind];
+	cell.recoCharge = recoCharge[ind];
+	cell.vertices.clear();
+	for (Long64_t vert = vertexOffset[ind]; vert < vertexOffset[ind+1]; ++vert) {
+	    cell.vertices.push_back(make_pair(vertexZ[vert], vertexY[vert]));
+	}
+    }
+    return true;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // constructCellMap - Construct map of Cells formed by three Wires (one from each plane)
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -916,32 +1187,52 @@ pair<pair<Double_t,Double_t>,pair<Double_t,Double_t> > getWireEndpoints(Int_t wi
   return endpoints;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// cellUniform - Uniform random number in [0,1) for a cell, the splitmix64 hash of the seed and cell ID
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+Double_t cellUniform(ULong64_t seed, Int_t cellID)
+{
+  ULong64_t x = seed + ((ULong64_t) cellID + 1)*0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30))*0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27))*0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return (x >> 11)*(1.0/9007199254740992.0);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // addCharges - Add true charge to Cells within CellMap, consistently adding charge to relevant Wires
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 void addCharges(CellMap &cellMap)
 {
-  TRandom3 *rand;
-  Double_t randNum;
-  Double_t tempCharge;
-  for(Int_t i = 0; i < cellMap.cells.size(); i++)
-  {
-    // Temporarily assign random charge for visualization purposes
-    rand = new TRandom3(0);
-    randNum = rand->Uniform(1.0);
-    if(randNum < 0.01*cellMap.cells.at(i).area/(pow(pow(wirePitchY*wirePitchU*wirePitchV,1.0/3.0),2)))
+  vector<Cell> &cells = cellMap.cells;
+  const Double_t unitArea = pow(pow(wirePitchY*wirePitchU*wirePitchV,1.0/3.0),2);
+
+  // Temporarily assign random charge for visualization purposes.  Each cell's number depends only on
+  // the seed and its ID, so the charges are the same for any number of threads.
+  const Int_t numBlocks = (cells.size()+chargeBlock-1)/chargeBlock;
+  WCP::parallel_for(numBlocks, numThreads, [&](Int_t block) {
+    const size_t lastCell = min(cells.size(), (size_t) (block+1)*chargeBlock);
+    for(size_t i = (size_t) block*chargeBlock; i < lastCell; i++)
     {
-      tempCharge = 100.0*randNum;
-      cellMap.cells.at(i).trueCharge = tempCharge;
-      // NOTE:  (SECOND COPY) In principal some wires that don't exist could be associated with a cell.  In the future we should merge such a cell with its adjacent cell that is formed from three wires that actually exist in the TPC.  This happens almost exclusively at the corners.  Also, the cells near the edges should change in shape due to different "closest wires"
-      if(cellMap.cells.at(i).UwireID < cellMap.Uwires.size())
-        cellMap.Uwires.at(cellMap.cells.at(i).UwireID).charge += tempCharge;
-      if(cellMap.cells.at(i).VwireID < cellMap.Vwires.size())
-        cellMap.Vwires.at(cellMap.cells.at(i).VwireID).charge += tempCharge;
-      if(cellMap.cells.at(i).YwireID < cellMap.Ywires.size())
-        cellMap.Ywires.at(cellMap.cells.at(i).YwireID).charge += tempCharge;
+      const Double_t randNum = cellUniform(chargeSeed,cells[i].ID);
+      if(randNum < 0.01*cells[i].area/unitArea)
+        cells[i].trueCharge = 100.0*randNum;
     }
-    delete rand;
+  });
+
+  // Wires are shared between cells, so their charge is summed serially in cell order
+  for(size_t i = 0; i < cells.size(); i++)
+  {
+    const Double_t tempCharge = cells[i].trueCharge;
+    if(tempCharge <= 0.0)
+      continue;
+    // NOTE:  (SECOND COPY) In principal some wires that don't exist could be associated with a cell.  In the future we should merge such a cell with its adjacent cell that is formed from three wires that actually exist in the TPC.  This happens almost exclusively at the corners.  Also, the cells near the edges should change in shape due to different "closest wires"
+    if(cells[i].UwireID < cellMap.Uwires.size())
+      cellMap.Uwires.at(cells[i].UwireID).charge += tempCharge;
+    if(cells[i].VwireID < cellMap.Vwires.size())
+      cellMap.Vwires.at(cells[i].VwireID).charge += tempCharge;
+    if(cells[i].YwireID < cellMap.Ywires.size())
+      cellMap.Ywires.at(cells[i].YwireID).charge += tempCharge;
   }
 
   assignHitTypes(cellMap);
@@ -0,0 +1,353 @@
+//
+//  TilingBenchmark - time TileMaker construction and queries over a range of detector sizes
+//
+//  Usage: TilingBenchmark [nthreads] [maxYwires] [height_cm]
+//
+//  Each (number of Y wires, U/V angle) point of the sweep builds a
+//  synthetic wire geometry in memory, tiles it and times the queries.
+//  Results are printed to stdout, one JSON object per line, including
+//  the TileMaker build statistics and the number of heap allocations
+//  made while constructing the tiling.
+//
+
+#include "WCPTiling/TileMaker.h"
+#include "WCPTiling/CellCoincidence.h"
+#include "WCPTiling/SliceExecutor.h"
+#include "WCPTiling/BlobFinder.h"
+#include "WCPTiling/ChargeDeposition.h"
+#include "WCPTiling/SyntheticGeometry.h"
+
+#include "WCPNav/GeomDataSource.h"
+#include "WCPData/GeomWire.h"
+#include "WCPData/Units.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+#include <sys/resource.h>
+
+using namespace WCP;
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Count every heap allocation made by the program.
+static std::atomic<long> heapAllocations(0);
+
+// The replacements are kept out of line so the compiler does not see
+// a new expression paired with malloc() and free() and warn of a
+// mismatch.
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+	throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+static long maxrss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// benchmark - Build and query one tiling, print one result line
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+static void benchmark(int numYwires, double angleDeg, double height, int nthreads)
+{
+    const double pitch = 3.0*units::mm;
+
+    Clock::time_point start = Clock::now();
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, numYwires, angleDeg*units::degree, pitch, height);
+    const double tGeometry = seconds_since(start);
+
+    TileMakerOptions opts;
+    opts.nthreads = nthreads;
+    opts.profile = true;
+
+    const long allocStart = heapAllocations.load();
+    start = Clock::now();
+    TileMaker tiling(gds, opts);
+    const double tConstruct = seconds_since(start);
+    const long constructAllocations = heapAllocations.load() - allocStart;
+
+    const CellStore& store = tiling.cellStore();
+    const int numCells = store.size();
+
+    // Materializing the GeomCell views happens on first use.
+    start = Clock::now();
+    tiling.geomCell(0);
+    const double tViews = seconds_since(start);
+
+    // wires(cell) for every cell
+    start = Clock::now();
+    size_t nwires = 0;
+    for (int ident = 0; ident < numCells; ++ident) {
+	nwires += tiling.wires(*tiling.geomCell(ident)).size();
+    }
+    const double tWires = seconds_since(start);
+
+    // cells(wire) for every wire
+    const WirePlaneType_t planes[3] = {kUwire, kVwire, kYwire};
+    start = Clock::now();
+    size_t ncells = 0, numWires = 0;
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	GeomWireSelection ws = gds.wires_in_plane(planes[iplane]);
+	numWires += ws.size();
+	for (size_t ind = 0; ind < ws.size(); ++ind) {
+	    ncells += tiling.cells(*ws[ind]).size();
+	}
+    }
+    const double tCells = seconds_since(start);
+
+    // cell(wires) for every cell
+    std::vector<GeomWireSelection> cellWires(numCells);
+    for (int ident = 0; ident < numCells; ++ident) {
+	cellWires[ident] = tiling.wires(*tiling.geomCell(ident));
+    }
+    start = Clock::now();
+    int nfound = 0;
+    for (int ident = 0; ident < numCells; ++ident) {
+	nfound += (tiling.cell(cellWires[ident]) != 0);
+    }
+    const double tCell = seconds_since(start);
+    std::vector<GeomWireSelection>().swap(cellWires);
+
+    // batched cellIDs over every cell's triple
+    std::vector<int> uindex(numCells), vindex(numCells), yindex(numCells), ids(numCells);
+    for (int ident = 0; ident < numCells; ++ident) {
+	uindex[ident] = store.uindex(ident);
+	vindex[ident] = store.vindex(ident);
+	yindex[ident] = store.yindex(ident);
+    }
+    start = Clock::now();
+    tiling.cellIDs(numCells, uindex.data(), vindex.data(), yindex.data(), ids.data());
+    const double tCellIDs = seconds_since(start);
+
+    // batched locate over every cell's center
+    std::vector<double> centerY(numCells), centerZ(numCells);
+    for (int ident = 0; ident < numCells; ++ident) {
+	centerY[ident] = store.centerY(ident);
+	centerZ[ident] = store.centerZ(ident);
+    }
+    start = Clock::now();
+    tiling.locate(numCells, centerY.data(), centerZ.data(), ids.data());
+    const double tLocate = seconds_since(start);
+    int nlocated = 0;
+    for (int ident = 0; ident < numCells; ++ident) {
+	nlocated += (ids[ident] == ident);
+    }
+
+    // three plane coincidence of a sparse event, the wires of 100
+    // cells spread over the tiling
+    start = Clock::now();
+    CellCoincidence coincidence(tiling);
+    const double tCoincidenceBuild = seconds_since(start);
+    std::vector<uint64_t> fired[3];
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	fired[iplane].assign(coincidence.nwords(planes[iplane]), 0);
+    }
+    for (int ind = 0; ind < 100; ++ind) {
+	const int ident = (long)ind*numCells/100;
+	const int windex[3] = {store.uindex(ident), store.vindex(ident), store.yindex(ident)};
+	for (int iplane = 0; iplane < 3; ++iplane) {
+	    if (windex[iplane] >= 0 && windex[iplane] < coincidence.nwires(planes[iplane])) {
+		fired[iplane][windex[iplane]/64] |= uint64_t(1) << (windex[iplane]%64);
+	    }
+	}
+    }
+    std::vector<int> coincident;
+    coincident.reserve(numCells);
+    const int coincidenceRepeats = 100;
+    start = Clock::now();
+    for (int ind = 0; ind < coincidenceRepeats; ++ind) {
+	coincident.clear();
+	coincidence.find(fired[0].data(), fired[1].data(), fired[2].data(), coincident);
+    }
+    const double tCoincidence = seconds_since(start)/coincidenceRepeats;
+
+    // a batch of slices with 1% of wires fired, imaged on the pool
+    const int numSlices = 256;
+    std::vector<float> charges[3];
+    std::vector<SliceFrame> frames(numSlices);
+    unsigned int seed = 1;
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	const int nplane = coincidence.nwires(planes[iplane]);
+	charges[iplane].assign((size_t)numSlices*nplane, 0.0);
+	for (size_t ind = 0; ind < charges[iplane].size(); ++ind) {
+	    seed = 1664525*seed + 1013904223;
+	    if (seed % 100 == 0) {
+		charges[iplane][ind] = 1.0;
+	    }
+	}
+	for (int slice = 0; slice < numSlices; ++slice) {
+	    frames[slice].slice = slice;
+	    frames[slice].charge[iplane] = charges[iplane].data() + (size_t)slice*nplane;
+	}
+    }
+    SliceExecutor executor(tiling, coincidence, nthreads);
+    std::vector<SliceCells> sliceCells;
+    executor.process(frames, sliceCells);
+    start = Clock::now();
+    executor.process(frames, sliceCells);
+    const double tSlices = seconds_since(start);
+
+    // the cells crossed by 0.5 mm steps along 100 tracks across the
+    // tiling, batched
+    const int numTracks = 100, stepsPerTrack = 1000;
+    std::vector<double> stepY1, stepZ1, stepY2, stepZ2;
+    for (int track = 0; track < numTracks; ++track) {
+	const int ident = (long)track*numCells/numTracks;
+	const double angle = track*360.0/numTracks*units::degree;
+	const double dY = 0.5*units::mm*sin(angle), dZ = 0.5*units::mm*cos(angle);
+	for (int step = 0; step < stepsPerTrack; ++step) {
+	    stepY1.push_back(store.centerY(ident) + step*dY);
+	    stepZ1.push_back(store.centerZ(ident) + step*dZ);
+	    stepY2.push_back(stepY1.back() + dY);
+	    stepZ2.push_back(stepZ1.back() + dZ);
+	}
+    }
+    const size_t numSteps = stepY1.size();
+    std::vector<CellCrossing> crossed;
+    std::vector<size_t> stepOffsets(numSteps+1);
+    start = Clock::now();
+    tiling.traverse(numSteps, stepY1.data(), stepZ1.data(), stepY2.data(), stepZ2.data(),
+		    crossed, stepOffsets.data());
+    const double tTraverse = seconds_since(start);
+
+    // unit charges at the starts of the steps deposited into cells
+    // and wires
+    ChargeDeposition deposition(tiling, nthreads);
+    std::vector<float> stepCharge(numSteps, 1.0);
+    start = Clock::now();
+    deposition.deposit(numSteps, stepY1.data(), stepZ1.data(), stepCharge.data());
+    const double tDeposit = seconds_since(start);
+
+    // the neighbor graph, then the blobs of the coincident cells of
+    // the sparse event
+    start = Clock::now();
+    const CellGraph& graph = tiling.cellGraph();
+    const double tGraph = seconds_since(start);
+    BlobFinder blobs(tiling, nthreads);
+    std::vector<int> labels(coincident.size());
+    start = Clock::now();
+    const int numBlobs = blobs.find(coincident.data(), coincident.size(), labels.data());
+    const double tBlobs = seconds_since(start);
+
+    const TileMakerStats& stats = tiling.stats();
+    const size_t bytes = store.memory() + tiling.cellWireIndex().memory()
+	+ tiling.wireTripleIndex().memory();
+
+    std::stringstream ss;
+    ss << "{\"nYwires\": " << numYwires
+       << ", \"angle_deg\": " << angleDeg
+       << ", \"height_cm\": " << height/units::cm
+       << ", \"nthreads\": " << nthreads
+       << ", \"crossings\": \"" << crossingsInstructionSet() << "\""
+       << ", \"nwires\": " << numWires
+       << ", \"ncells\": " << numCells
+       << ", \"candidate_pairs\": " << stats.formsCellCalls
+       << ", \"forms_cell_accepts\": " << stats.formsCellAccepts
+       << ", \"cells_discarded\": " << stats.cellsDiscarded
+       << ", \"cells_trimmed\": " << stats.cellsTrimmed
+       << ", \"cells_sorted\": " << stats.cellsSorted
+       << ", \"period\": " << stats.period
+       << ", \"chains_replicated\": " << stats.chainsReplicated
+       << ", \"chain_allocations\": " << stats.allocations
+       << ", \"construct_allocations\": " << constructAllocations
+       << ", \"allocations_per_cell\": " << double(constructAllocations)/std::max(numCells,1)
+       << ", \"setup_s\": " << stats.setupTime
+       << ", \"chain_s\": " << stats.chainTime
+       << ", \"vertex_cpu_s\": " << stats.vertexTime
+       << ", \"trim_cpu_s\": " << stats.trimTime
+       << ", \"store_s\": " << stats.storeTime
+       << ", \"wiremap_s\": " << stats.wireMapTime
+       << ", \"geometry_s\": " << tGeometry
+       << ", \"construct_s\": " << tConstruct
+       << ", \"geomcell_views_s\": " << tViews
+       << ", \"wires_per_cell_ns\": " << 1e9*tWires/std::max(numCells,1)
+       << ", \"cells_per_wire_ns\": " << 1e9*tCells/std::max(numWires,(size_t)1)
+       << ", \"cell_from_wires_ns\": " << 1e9*tCell/std::max(numCells,1)
+       << ", \"cellids_batch_ns\": " << 1e9*tCellIDs/std::max(numCells,1)
+       << ", \"locate_batch_ns\": " << 1e9*tLocate/std::max(numCells,1)
+       << ", \"coincidence_build_s\": " << tCoincidenceBuild
+       << ", \"coincidence_sparse_us\": " << 1e6*tCoincidence
+       << ", \"coincident_cells\": " << coincident.size()
+       << ", \"slice_us\": " << 1e6*tSlices/numSlices
+       << ", \"slice_steals\": " << executor.steals()
+       << ", \"traverse_step_ns\": " << 1e9*tTraverse/numSteps
+       << ", \"traverse_cells_per_step\": " << double(crossed.size())/numSteps
+       << ", \"deposit_ns\": " << 1e9*tDeposit/numSteps
+       << ", \"deposit_cells\": " << deposition.cells().size()
+       << ", \"graph_s\": " << tGraph
+       << ", \"graph_neighbors\": " << double(graph.offsets()[graph.ncells()])/std::max(numCells,1)
+       << ", \"blobs_us\": " << 1e6*tBlobs
+       << ", \"blobs\": " << numBlobs
+       << ", \"found\": " << nfound
+       << ", \"located\": " << nlocated
+       << ", \"wire_refs\": " << nwires
+       << ", \"cell_refs\": " << ncells
+       << ", \"tiling_bytes\": " << bytes
+       << ", \"maxrss_kb\": " << maxrss_kb()
+       << "}";
+    std::cout << ss.str() << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// main - Sweep Y wire counts and U/V angles
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    int nthreads = 1;
+    int maxYwires = 10000;
+    double height = 230.0*units::cm;
+    if (argc > 1) {
+	nthreads = atoi(argv[1]);
+    }
+    if (argc > 2) {
+	maxYwires = atoi(argv[2]);
+    }
+    if (argc > 3) {
+	height = atof(argv[3])*units::cm;
+    }
+
+    const int numYwiresSweep[] = {100, 300, 1000, 3000, 10000};
+    const double angleSweep[] = {60.0, 45.0, 35.7};
+
+    for (size_t iy = 0; iy < sizeof(numYwiresSweep)/sizeof(int); ++iy) {
+	if (numYwiresSweep[iy] > maxYwires) {
+	    break;
+	}
+	for (size_t ia = 0; ia < sizeof(angleSweep)/sizeof(double); ++ia) {
+	    benchmark(numYwiresSweep[iy], angleSweep[ia], height, nthreads);
+	}
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef WIRECELL_BLOBFINDER_H
+#define WIRECELL_BLOBFINDER_H
+
+#include "WCPTiling/TileMaker.h"
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace WCP {
+
+    /** WCP::BlobFinder - group fired cells into blobs, the connected
+	clusters of the tiling's cell neighbor graph.
+
+	The cells are joined with a lock-free union-find over their
+	positions in the list.  A union always hangs the root of the
+	later set under the root of the earlier one, so every set is
+	rooted at its first cell whichever thread joins it, and the
+	blobs found do not depend on the number of threads.
+
+	A finder holds scratch space sized by the tiling and should be
+	used by one caller at a time, the threads it runs being its
+	own.
+     */
+    class BlobFinder {
+    public:
+	/// Make a finder using nthreads for long lists of cells, zero
+	/// for one per hardware thread.
+	BlobFinder(const TileMaker& tiling, int nthreads = 1);
+	~BlobFinder();
+
+	/// Label each of n distinct cells with its blob, labels[i]
+	/// for cells[i].  Blobs are numbered from zero in the order
+	/// of their first cell in the list.  Returns the number of
+	/// blobs.
+	int find(const int* cells, size_t n, int* labels);
+
+    private:
+	int root(int ind);
+	void unite(int ind1, int ind2);
+
+	const CellGraph& graph;
+	int nthreads;
+	std::vector<int> local;		// cell ID -> position in the list or -1
+	std::unique_ptr<std::atomic<int>[]> parent;
+	size_t capacity;
+    };
+
+}
+#endif
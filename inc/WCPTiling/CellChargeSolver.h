@@ -0,0 +1,102 @@
+#ifndef WIRECELL_CELLCHARGESOLVER_H
+#define WIRECELL_CELLCHARGESOLVER_H
+
+#include "WCPTiling/WireCellResponse.h"
+
+#include <vector>
+#include <cstddef>
+
+namespace WCP {
+
+    /// Options controlling a CellChargeSolver.
+    struct CellChargeSolverOptions {
+	CellChargeSolverOptions();
+
+	/// Most iterations per solve.
+	int maxIterations;
+
+	/// Stop once the residual changes by less than this fraction
+	/// in one iteration.  Zero always runs maxIterations.
+	double tolerance;
+
+	/// Threads used for the matrix-vector products of large
+	/// problems.  One is serial, zero uses every hardware thread.
+	int nthreads;
+
+	/// If true, cells solved by the previous call start from the
+	/// charge found then.
+	bool warmStart;
+    };
+
+    /// What one solve did.  Times are wall clock seconds.
+    struct CellChargeSolverStats {
+	CellChargeSolverStats();
+
+	int iterations;		// updates of the cell charges
+	bool converged;		// stopped by the tolerance
+	double residual;	// |Ax-b|/|b| at the end
+	int warmCells;		// cells started from the previous solve
+	double setupTime;	// building the response and the start
+	double iterateTime;
+	double totalTime;
+    };
+
+    /** WCP::CellChargeSolver - find non-negative cell charges which
+	reproduce the charges seen on the wires.
+
+	The cells of a slice and the wires they share give the small
+	response A of a WireCellSubset, and the solver minimizes
+	|Ax-b| over x >= 0 for the wire charges b, negative wire
+	charges being taken as zero.  Ghost cells, which owe their
+	wire charge to real cells sharing their wires, are driven to
+	zero.  The iteration is the multiplicative update
+
+	    x <- x * (A'b) / (A'Ax)
+
+	which keeps x non-negative and needs only two sparse products
+	per step, each split over threads by rows.
+
+	The solver keeps the charge of every cell from the previous
+	solve, so consecutive time slices may start warm.  One solver
+	should be used by one thread at a time.
+     */
+    class CellChargeSolver {
+    public:
+	CellChargeSolver(const TileMaker& tiling,
+			 const CellChargeSolverOptions& options = CellChargeSolverOptions());
+	~CellChargeSolver();
+
+	/// Solve for the charges of n cells from the wire charges of
+	/// each plane, indexed by wire index in the plane.  The
+	/// result holds one charge per cell in the order given.
+	const std::vector<double>& solve(const int* cells, size_t n, const float* Ucharge,
+					 const float* Vcharge, const float* Ycharge);
+
+	/// The charges found by the last solve.
+	const std::vector<double>& charges() const { return x; }
+
+	/// The response of the last solve.
+	const WireCellSubset& subset() const { return sub; }
+
+	/// What the last solve did.
+	const CellChargeSolverStats& stats() const { return solveStats; }
+
+    private:
+	const CellWireIndex& index;
+	WireCellResponse response;
+	CellChargeSolverOptions opts;
+	CellChargeSolverStats solveStats;
+
+	// The current problem in local numbering
+	WireCellSubset sub;
+	std::vector<double> x, b, Atb, Ax;
+	std::vector<double> partial;
+
+	// The charge of each cell by ID when last solved
+	std::vector<double> lastCharge;
+	std::vector<long> lastSolve;
+	long numSolves;
+    };
+
+}
+#endif
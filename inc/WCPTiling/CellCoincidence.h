@@ -0,0 +1,58 @@
+#ifndef WIRECELL_CELLCOINCIDENCE_H
+#define WIRECELL_CELLCOINCIDENCE_H
+
+#include "WCPTiling/TileMaker.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace WCP {
+
+    /** WCP::CellCoincidence - find the cells of a tiling whose U, V
+	and Y wires all fired.
+
+	Fired wires are given as one bitset per plane, bit i of word
+	i/64 standing for the wire of index i in the plane.  The cells
+	of each Y wire are kept ordered by their U wire with a table
+	from U wire to the first of its cells, so only the cells of
+	fired Y wires whose U wire also fired are visited.
+	The cost grows with the number of fired Y wires and the U
+	wires crossing them, not with the number of cells.  Cells
+	formed with a wire missing from its plane never fire.
+
+	The engine is read only once made and may be shared by any
+	number of threads.  It refers to the tiling's cells by ID and
+	does not need the tiling afterwards.
+     */
+    class CellCoincidence {
+    public:
+	explicit CellCoincidence(const TileMaker& tiling);
+	~CellCoincidence();
+
+	/// Number of wires in a plane.
+	int nwires(WirePlaneType_t plane) const { return numWires[plane]; }
+
+	/// Number of 64 bit words of a plane's fired wire bitset.
+	int nwords(WirePlaneType_t plane) const { return (numWires[plane]+63)/64; }
+
+	/// Append to cells the IDs of the cells whose three wires are
+	/// set in the bitsets, grouped by Y wire.  Returns the number
+	/// appended.  Bits beyond the wires of a plane are ignored.
+	size_t find(const uint64_t* Ufired, const uint64_t* Vfired, const uint64_t* Yfired,
+		    std::vector<int>& cells) const;
+
+	/// Approximate number of bytes held by the engine.
+	size_t memory() const;
+
+    private:
+	int numWires[3];
+	// The cells of each Y wire are ordered by U and then V wire
+	// index.  For Y wire i, U wire firstU[i]+k forms the cells
+	// [uTable[j+k], uTable[j+k+1]) with j = yTable[i].
+	std::vector<int> firstU, yTable, uTable;
+	std::vector<int> cellV, cellID;
+    };
+
+}
+#endif
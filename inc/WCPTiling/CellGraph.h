@@ -0,0 +1,75 @@
+#ifndef WIRECELL_CELLGRAPH_H
+#define WIRECELL_CELLGRAPH_H
+
+#include "WCPTiling/CellStore.h"
+#include "WCPTiling/CellWireIndex.h"
+#include "WCPTiling/FlatArray.h"
+
+#include <cstddef>
+
+namespace WCP {
+
+    /// The wire strips cells are made of.  The fractional index of
+    /// the nearest wire of a plane to a point is wire[plane][0]*Z +
+    /// wire[plane][1]*Y + wire[plane][2], so the strip of wire i
+    /// spans i-0.5 to i+0.5, and wire[plane][3] is a tolerance in
+    /// units of the index.  Cells are clipped to Z in [area[0],
+    /// area[1]] and Y in [area[2], area[3]], to within tolerance.
+    struct StripGeometry {
+	double wire[3][4];
+	double area[4];
+	double tolerance;
+    };
+
+    /** WCP::CellGraph - the neighbors of each cell of a tiling in
+	compressed sparse row form.
+
+	Two cells are neighbors if they touch, sharing an edge or a
+	corner.  Touching cells lie in the same or adjacent strips of
+	every plane, so the candidates are the cells of the same and
+	the two adjacent Y wires whose U and V wire indices differ by
+	at most one.  Whether a candidate touches follows from the
+	strips alone.  Cells differing in one plane both cut the strip
+	edge between them and share a stretch of it.  Cells differing
+	in two or three planes can only share the point where the
+	edges between them cross, and touch if that point lies on the
+	strip, or edge, of the remaining plane and in the active area.
+	No cell vertices are read.  The neighbors of a cell are in
+	ascending ID order.
+
+	Once built the graph is read only and may be queried from any
+	number of threads.
+     */
+    class CellGraph {
+    public:
+	CellGraph();
+	~CellGraph();
+
+	/// (Re)build the graph of the cells in the store, made of the
+	/// given strips, taking the cells of each Y wire from the
+	/// index, with nthreads.
+	void build(const CellStore& store, const CellWireIndex& index, const StripGeometry& strips,
+		   int nthreads = 1);
+
+	/// Number of cells.
+	int ncells() const { return offset.empty() ? 0 : offset.size()-1; }
+
+	/// The range [begin,end) of IDs of the cell's neighbors.
+	const int* neighborsBegin(int cell) const { return neighbor.data() + offset[cell]; }
+	const int* neighborsEnd(int cell) const { return neighbor.data() + offset[cell+1]; }
+	int nneighbors(int cell) const { return offset[cell+1] - offset[cell]; }
+
+	/// The graph as compressed sparse row arrays.
+	const int* offsets() const { return offset.data(); }
+	const int* neighbors() const { return neighbor.data(); }
+
+	/// Approximate number of bytes held by the graph.
+	size_t memory() const;
+
+    private:
+	FlatArray<int> offset;
+	FlatArray<int> neighbor;
+    };
+
+}
+#endif
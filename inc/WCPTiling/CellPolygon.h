@@ -0,0 +1,48 @@
+#ifndef WIRECELL_CELLPOLYGON_H
+#define WIRECELL_CELLPOLYGON_H
+
+#include <utility>
+
+namespace WCP {
+
+    /** WCP::CellPolygon - the (Z,Y) vertices of one cell held in
+	place, without touching the heap.
+
+	A cell is the overlap of three wire strips, at most a hexagon,
+	and trimming at the edges of the active area adds at most one
+	vertex per edge.  Before ordering, the candidate list holds at
+	most the twelve strip edge intersections.  The capacity covers
+	both with room to spare.  Vertices beyond it are dropped.
+     */
+    class CellPolygon {
+    public:
+	typedef std::pair<double,double> Vertex;
+
+	enum { capacity = 16 };
+
+	CellPolygon() : nvertices(0) {}
+
+	int size() const { return nvertices; }
+	bool empty() const { return nvertices == 0; }
+	void clear() { nvertices = 0; }
+
+	void push_back(const Vertex& vertex) {
+	    if (nvertices < capacity) {
+		vertices[nvertices++] = vertex;
+	    }
+	}
+
+	const Vertex& operator[](int ind) const { return vertices[ind]; }
+	Vertex& operator[](int ind) { return vertices[ind]; }
+
+	const Vertex* data() const { return vertices; }
+	const Vertex* begin() const { return vertices; }
+	const Vertex* end() const { return vertices+nvertices; }
+
+    private:
+	Vertex vertices[capacity];
+	int nvertices;
+    };
+
+}
+#endif
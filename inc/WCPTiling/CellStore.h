@@ -0,0 +1,132 @@
+#ifndef WIRECELL_CELLSTORE_H
+#define WIRECELL_CELLSTORE_H
+
+#include "WCPTiling/FlatArray.h"
+
+#include "WCPData/GeomCell.h"
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+namespace WCP {
+
+    class TilingCacheWriter;
+    class TilingCacheReader;
+
+    /** WCP::CellStore - flat storage of the cells of a tiling.
+
+	Cells are held as a struct of arrays and are identified by
+	their dense index into them, which is also their GeomCell
+	ident.  The vertices of all cells are packed into one pair of
+	(Z,Y) arrays with cell i owning [offset(i), offset(i+1)).
+	Each cell also records the index of its U, V and Y wire in
+	the wire plane, which may fall outside the plane for cells in
+	the corners of the tiling.
+
+	A store may be compacted into a shape dictionary.  Cells which
+	are translated copies of one another then share one entry in
+	a table of shapes, whose vertices are relative to the cell
+	center, and keep only their center.  Vertices and area are
+	computed from the shape on demand.  Cells with a shape of
+	their own, such as those clipped at the edges, keep explicit
+	vertices.
+     */
+    class CellStore {
+    public:
+	CellStore();
+	~CellStore();
+
+	/// Append a cell from its nvertices ordered (Z,Y) vertices,
+	/// returning its ID.
+	int add(const std::pair<double,double>* vertices, int nvertices,
+		const std::pair<double,double>& center, double area,
+		int uindex, int vindex, int yindex);
+
+	/// Reserve room for the given number of cells and vertices.
+	void reserve(size_t ncells, size_t nvertices);
+
+	/// Drop all cells.
+	void clear();
+
+	/// Move cells which are translations of another cell, to
+	/// within tolerance, into a shared shape table.  Gives up,
+	/// returning false, if there are too few repeated shapes for
+	/// this to save memory.  Cells added later are explicit.
+	bool compact(double tolerance);
+
+	/// True if the store holds a shape table.
+	bool compacted() const { return !cellShape.empty(); }
+
+	/// Number of cells.
+	int size() const { return Uindex.size(); }
+
+	/// Number of shapes in the shape table.
+	int nshapes() const { return shapeArea.size(); }
+
+	/// The cell's index in the shape table, or a negative number
+	/// if the cell has explicit vertices.
+	int shape(int id) const { return cellShape.empty() ? ~id : cellShape[id]; }
+
+	/// Number of vertices of the cell.
+	int nvertices(int id) const {
+	    const int sh = shape(id);
+	    return sh >= 0 ? shapeVertexOffset[sh+1] - shapeVertexOffset[sh]
+		: vertexOffset[~sh+1] - vertexOffset[~sh];
+	}
+
+	/// Z and Y coordinates of the cell's ind'th vertex.
+	double vertexZ(int id, int ind) const {
+	    const int sh = shape(id);
+	    return sh >= 0 ? centerZval[id] + shapeVertexZval[shapeVertexOffset[sh]+ind]
+		: vertexZval[vertexOffset[~sh]+ind];
+	}
+	double vertexY(int id, int ind) const {
+	    const int sh = shape(id);
+	    return sh >= 0 ? centerYval[id] + shapeVertexYval[shapeVertexOffset[sh]+ind]
+		: vertexYval[vertexOffset[~sh]+ind];
+	}
+
+	/// Center and area of the cell.
+	double centerZ(int id) const { return centerZval[id]; }
+	double centerY(int id) const { return centerYval[id]; }
+	double area(int id) const {
+	    const int sh = shape(id);
+	    return sh >= 0 ? shapeArea[sh] : cellArea[~sh];
+	}
+
+	/// Wire indices forming the cell.
+	int uindex(int id) const { return Uindex[id]; }
+	int vindex(int id) const { return Vindex[id]; }
+	int yindex(int id) const { return Yindex[id]; }
+
+	/// The boundary of the cell as 3D points (X=0).
+	PointVector boundary(int id) const;
+
+	/// A GeomCell equivalent of the cell.
+	GeomCell geomcell(int id) const;
+
+	/// Approximate number of bytes held by the store.
+	size_t memory() const;
+
+	/// Append the store's arrays to a tiling cache.
+	void save(TilingCacheWriter& out) const;
+
+	/// Make the store a view of arrays in a mapped tiling cache.
+	bool load(TilingCacheReader& in);
+
+    private:
+	// Per cell
+	FlatArray<double> centerZval, centerYval;
+	FlatArray<int> Uindex, Vindex, Yindex;
+	FlatArray<int> cellShape;	// empty unless compacted
+	// Per cell with explicit vertices
+	FlatArray<int> vertexOffset;
+	FlatArray<double> vertexZval, vertexYval, cellArea;
+	// Per shape
+	FlatArray<int> shapeVertexOffset;
+	FlatArray<double> shapeVertexZval, shapeVertexYval, shapeArea;
+    };
+
+}
+#endif
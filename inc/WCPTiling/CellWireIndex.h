@@ -0,0 +1,84 @@
+#ifndef WIRECELL_CELLWIREINDEX_H
+#define WIRECELL_CELLWIREINDEX_H
+
+#include "WCPTiling/CellStore.h"
+#include "WCPTiling/FlatArray.h"
+
+#include "WCPData/GeomWire.h"
+
+#include <vector>
+
+namespace WCP {
+
+    /** WCP::CellWireIndex - compressed sparse row adjacency between
+	the cells of a CellStore and the wires of the three planes.
+
+	Wires are given one global number, U wires first, then V and
+	then Y, so that a wire of index i in a plane has number
+	offset(plane)+i.  Each cell has exactly three entries, its U,
+	V and Y wire numbers, with -1 standing in for a wire which
+	does not exist in the plane.  Each wire has a contiguous,
+	ascending range of the IDs of the cells it forms.
+
+	Once built the index is read only and may be queried from any
+	number of threads.
+     */
+    class CellWireIndex {
+    public:
+	CellWireIndex();
+	~CellWireIndex();
+
+	/// (Re)build the index from the cells of the store and the
+	/// number of wires in each plane.
+	void build(const CellStore& store, int nUwires, int nVwires, int nYwires);
+
+	/// Number of cells indexed.
+	int ncells() const { return cellWire.size()/3; }
+
+	/// Total number of wires over all planes.
+	int nwires() const { return planeOffset[3]; }
+
+	/// Number of wires in one plane.
+	int nwires(WirePlaneType_t plane) const { return planeOffset[plane+1]-planeOffset[plane]; }
+
+	/// Global number of the index'th wire of the plane or -1 if
+	/// no such wire exists.
+	int wire(WirePlaneType_t plane, int index) const;
+
+	/// The plane and the index in the plane of a global wire number.
+	WirePlaneType_t plane(int wire) const;
+	int index(int wire) const { return wire - planeOffset[plane(wire)]; }
+
+	/// The three (U,V,Y) global wire numbers of the cell, -1 for
+	/// wires which do not exist.
+	const int* cellWires(int cell) const { return &cellWire[3*cell]; }
+
+	/// The range [begin,end) of IDs of cells formed by the wire.
+	const int* cellsBegin(int wire) const { return wireCell.data() + wireCellOffset[wire]; }
+	const int* cellsEnd(int wire) const { return wireCell.data() + wireCellOffset[wire+1]; }
+	int ncells(int wire) const { return wireCellOffset[wire+1] - wireCellOffset[wire]; }
+
+	/// The wire to cell map as compressed sparse row arrays, wire
+	/// w forming cells [wireCells()+wireCellOffsets()[w], ...
+	/// wireCells()+wireCellOffsets()[w+1]).
+	const int* wireCellOffsets() const { return wireCellOffset.data(); }
+	const int* wireCells() const { return wireCell.data(); }
+
+	/// Approximate number of bytes held by the index.
+	size_t memory() const;
+
+	/// Append the index's arrays to a tiling cache.
+	void save(TilingCacheWriter& out) const;
+
+	/// Make the index a view of arrays in a mapped tiling cache.
+	bool load(TilingCacheReader& in);
+
+    private:
+	int planeOffset[4];
+	FlatArray<int> cellWire;
+	FlatArray<int> wireCellOffset;
+	FlatArray<int> wireCell;
+    };
+
+}
+#endif
@@ -0,0 +1,89 @@
+#ifndef WIRECELL_CHARGEDEPOSITION_H
+#define WIRECELL_CHARGEDEPOSITION_H
+
+#include "WCPTiling/TileMaker.h"
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace WCP {
+
+    /** WCP::ChargeDeposition - add point charges to the cells
+	containing them and to the wires of those cells.
+
+	The points are located in blocks with TileMaker::locate() and
+	the blocks are shared among the threads.  A thread sums runs
+	of points in the same cell before adding them to the cell,
+	with an atomic compare and swap, so threads rarely contend
+	for a cell.  Wires are few and hit by many points, so each
+	thread sums its own wire charges which are added to the
+	totals in thread order at the end of each deposit().  That
+	merge visits every wire of every thread, so each deposit()
+	costs O(nthreads*nwires) besides the points; deposit many
+	points per call.
+
+	With more than one thread the order of additions varies from
+	run to run, so cell totals and wire totals both may differ in
+	the last bits: cells are added to as threads reach them and
+	blocks go to whichever thread is free, so which points a
+	thread's wire sums hold changes too.  Whole number charges
+	sum exactly in any order.
+
+	Totals accumulate over calls to deposit() until clear(),
+	which only visits the cells given charge.  A deposition
+	should be used by one caller at a time.
+     */
+    class ChargeDeposition {
+    public:
+	/// Make a deposition into the cells of the tiling using
+	/// nthreads for many points, zero for one per hardware
+	/// thread.
+	ChargeDeposition(const TileMaker& tiling, int nthreads = 1);
+	~ChargeDeposition();
+
+	/// Add the charges of n points at (Y,Z).  Returns the number
+	/// of points in no cell, whose charge is dropped.
+	size_t deposit(size_t n, const double* Yval, const double* Zval, const float* charge);
+
+	/// Zero all cell and wire totals.
+	void clear();
+
+	/// The charge deposited in the cell.
+	double cellCharge(int cell) const { return cellTotal[cell].load(std::memory_order_relaxed); }
+
+	/// The cells given charge since the last clear(), in
+	/// ascending ID order.
+	const std::vector<int>& cells() const { return touched; }
+
+	/// The charge deposited on each wire of the plane, by wire
+	/// index in the plane.
+	const std::vector<double>& wireCharge(WirePlaneType_t plane) const { return wireTotal[plane]; }
+
+	/// Points deposited and points dropped since the last clear().
+	size_t npoints() const { return numPoints; }
+	size_t nmissed() const { return numMissed; }
+
+    private:
+	// What one thread gathers during a deposit()
+	struct Worker {
+	    std::vector<int> ids;
+	    std::vector<double> wireCharge[3];
+	    std::vector<int> touched;
+	    size_t missed;
+	};
+
+	const TileMaker& tiling;
+	const CellStore& store;
+	int nthreads;
+	std::unique_ptr<std::atomic<double>[]> cellTotal;
+	std::unique_ptr<std::atomic<char>[]> cellTouched;
+	std::vector<int> touched;
+	std::vector<double> wireTotal[3];
+	std::vector<Worker> workers;
+	size_t numPoints, numMissed;
+    };
+
+}
+#endif
@@ -0,0 +1,43 @@
+#ifndef WIRECELL_COUNTINGALLOCATOR_H
+#define WIRECELL_COUNTINGALLOCATOR_H
+
+#include <memory>
+#include <cstddef>
+
+namespace WCP {
+
+    /// Number of allocations made by any CountingAllocator in the
+    /// calling thread since it started.
+    long& thread_allocation_count();
+
+    /** WCP::CountingAllocator - std::allocator which counts, per
+	thread, every allocation it makes.  Containers on hot paths
+	use it so their heap traffic shows up in statistics.
+     */
+    template<typename T>
+    class CountingAllocator : public std::allocator<T> {
+    public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef size_t size_type;
+	template<typename U> struct rebind { typedef CountingAllocator<U> other; };
+
+	CountingAllocator() {}
+	template<typename U> CountingAllocator(const CountingAllocator<U>&) {}
+
+	T* allocate(size_t n) {
+	    ++thread_allocation_count();
+	    return std::allocator<T>::allocate(n);
+	}
+	void deallocate(T* ptr, size_t n) {
+	    std::allocator<T>::deallocate(ptr, n);
+	}
+    };
+
+    template<typename T, typename U>
+    bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) { return true; }
+    template<typename T, typename U>
+    bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) { return false; }
+
+}
+#endif
@@ -0,0 +1,66 @@
+#ifndef WIRECELL_CROSSINGKERNEL_H
+#define WIRECELL_CROSSINGKERNEL_H
+
+namespace WCP {
+
+    /// The constants of one Y wire strip which the candidate
+    /// vertices of its cells depend on.  Y values of U and V wires
+    /// are their crossings with the strip's center line.
+    struct CrossingStrip {
+	double Zval;		// center of the Y wire strip
+	double Z1, Z2;		// its lower and upper Z edges
+	double Uslope, Vslope;	// dY/dZ of U and V wires
+	double UhalfWidth;	// half the U strip width along Y
+	double VhalfWidth;	// half the V strip width along Y
+	double epsilon;
+    };
+
+    /** WCP::CrossingBatch - the twelve candidate vertices of up to
+	capacity cells on one Y wire strip, computed together.
+
+	Candidate k of cell i is (Z[k][i], Y[k][i]) and is a vertex
+	of the cell if bit k of mask[i] is set.  Candidates are in the
+	order TileMaker has always collected them, Y strip edges with
+	U and V strip edges first, then the U/V corners.
+     */
+    struct CrossingBatch {
+	enum { capacity = 16 };
+	enum Candidate {
+	    kY1U1, kY1U2, kY1V1, kY1V2,
+	    kY2U1, kY2U2, kY2V1, kY2V2,
+	    kU1V1, kU1V2, kU2V1, kU2V2,
+	    kNumCandidates
+	};
+
+	CrossingBatch() : size(0) {}
+
+	// Input, the U and V crossings of each cell
+	int size;
+	double Uval[capacity];
+	double Vval[capacity];
+
+	// Output
+	double Z[kNumCandidates][capacity];
+	double Y[kNumCandidates][capacity];
+	unsigned int mask[capacity];
+	// Bounding box of the four U/V corners
+	double UVminZ[capacity], UVmaxZ[capacity];
+	double UVminY[capacity], UVmaxY[capacity];
+    };
+
+    /// Fill the candidate vertices of a batch, using the widest
+    /// vector instructions compiled in.  The results are identical
+    /// to crossingsScalar().  The instruction set is chosen when the
+    /// library is compiled, from those the compiler targets, such as
+    /// -mavx2 or -mavx512f, and is not detected at run time.  A
+    /// build for generic x86-64 runs the scalar kernel.
+    void crossings(const CrossingStrip& strip, CrossingBatch& batch);
+
+    /// Fill the candidate vertices of a batch one cell at a time.
+    void crossingsScalar(const CrossingStrip& strip, CrossingBatch& batch);
+
+    /// Name of the instruction set used by crossings().
+    const char* crossingsInstructionSet();
+
+}
+#endif
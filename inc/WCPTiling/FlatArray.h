@@ -0,0 +1,100 @@
+#ifndef WIRECELL_FLATARRAY_H
+#define WIRECELL_FLATARRAY_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+namespace WCP {
+
+    /** WCP::FlatArray - a contiguous array which either owns its
+	elements or is a read only view of memory owned elsewhere,
+	such as a memory mapped tiling cache.
+
+	Building operations (push_back, resize, ...) turn a view into
+	an owned, empty array first.  Reading is the same either way.
+	Copying a view copies the view, not the elements, so it must
+	not outlive the memory it refers to.
+     */
+    template<typename T>
+    class FlatArray {
+    public:
+	FlatArray() : ptr(0), len(0) {}
+	FlatArray(const FlatArray& other) { *this = other; }
+	FlatArray& operator=(const FlatArray& other) {
+	    if (this == &other) {
+		return *this;
+	    }
+	    if (other.isView()) {
+		owned.clear();
+		ptr = other.ptr;
+		len = other.len;
+	    }
+	    else {
+		owned = other.owned;
+		sync();
+	    }
+	    return *this;
+	}
+
+	/// Refer to n elements at data without copying them.
+	void attach(const T* data, size_t n) {
+	    std::vector<T>().swap(owned);
+	    ptr = data;
+	    len = n;
+	}
+
+	bool isView() const { return ptr != 0 && ptr != owned.data(); }
+
+	/// Exchange contents, owned or viewed, with another array.
+	void swap(FlatArray& other) {
+	    owned.swap(other.owned);
+	    std::swap(ptr, other.ptr);
+	    std::swap(len, other.len);
+	}
+
+	size_t size() const { return len; }
+	bool empty() const { return len == 0; }
+	const T* data() const { return ptr; }
+	const T& operator[](size_t ind) const { return ptr[ind]; }
+	const T* begin() const { return ptr; }
+	const T* end() const { return ptr+len; }
+
+	// Building, these always act on owned elements.
+	T* mutable_data() { own(); return owned.data(); }
+	void push_back(const T& val) { own(); owned.push_back(val); sync(); }
+	void resize(size_t n) { own(); owned.resize(n); sync(); }
+	void assign(size_t n, const T& val) { own(); owned.assign(n, val); sync(); }
+	void reserve(size_t n) { own(); owned.reserve(n); sync(); }
+	void clear() { own(); owned.clear(); sync(); }
+
+	/// Bytes held, owned or viewed.
+	size_t memory() const { return isView() ? len*sizeof(T) : owned.capacity()*sizeof(T); }
+
+    private:
+	void own() { if (isView()) { ptr = 0; len = 0; } }
+	void sync() { ptr = owned.data(); len = owned.size(); }
+
+	std::vector<T> owned;
+	const T* ptr;
+	size_t len;
+    };
+
+    /// True if the offsets into an array of the given size start at
+    /// zero, never decrease and end at its size, as compressed sparse
+    /// row offsets read back from a file must before they are used.
+    template<typename T>
+    bool validOffsets(const FlatArray<T>& offset, size_t size) {
+	if (offset.empty() || offset[0] != 0 || (size_t)offset[offset.size()-1] != size) {
+	    return false;
+	}
+	for (size_t ind = 1; ind < offset.size(); ++ind) {
+	    if (offset[ind] < offset[ind-1]) {
+		return false;
+	    }
+	}
+	return true;
+    }
+
+}
+#endif
@@ -0,0 +1,75 @@
+#ifndef WIRECELL_PARALLELFOR_H
+#define WIRECELL_PARALLELFOR_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+
+namespace WCP {
+
+    /// Return the number of threads to actually use for a request of
+    /// nthreads.  Zero or negative means one per hardware thread.
+    inline int resolve_nthreads(int nthreads)
+    {
+	if (nthreads > 0) {
+	    return nthreads;
+	}
+	int nhw = std::thread::hardware_concurrency();
+	return nhw > 0 ? nhw : 1;
+    }
+
+    /** WCP::parallel_for - call func(index) for every index in [0,n).
+
+	Indices are handed out one at a time from a shared counter so
+	uneven work per index balances itself across threads.  With a
+	single thread (or a single index) func runs inline in the
+	calling thread.  The first exception thrown by func is
+	rethrown after all threads have joined.
+     */
+    template<typename Func>
+    void parallel_for(int n, int nthreads, Func func)
+    {
+	nthreads = resolve_nthreads(nthreads);
+	if (nthreads > n) {
+	    nthreads = n;
+	}
+	if (nthreads <= 1) {
+	    for (int ind = 0; ind < n; ++ind) {
+		func(ind);
+	    }
+	    return;
+	}
+
+	std::atomic<int> next(0);
+	std::exception_ptr error;
+	std::mutex error_mutex;
+
+	std::vector<std::thread> threads;
+	for (int ithread = 0; ithread < nthreads; ++ithread) {
+	    threads.push_back(std::thread([&]() {
+		try {
+		    for (int ind = next++; ind < n; ind = next++) {
+			func(ind);
+		    }
+		}
+		catch (...) {
+		    std::lock_guard<std::mutex> lock(error_mutex);
+		    if (!error) {
+			error = std::current_exception();
+		    }
+		    next = n;
+		}
+	    }));
+	}
+	for (size_t ind = 0; ind < threads.size(); ++ind) {
+	    threads[ind].join();
+	}
+	if (error) {
+	    std::rethrow_exception(error);
+	}
+    }
+
+}
+#endif
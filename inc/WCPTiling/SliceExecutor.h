@@ -0,0 +1,84 @@
+#ifndef WIRECELL_SLICEEXECUTOR_H
+#define WIRECELL_SLICEEXECUTOR_H
+
+#include "WCPTiling/SliceImager.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+
+namespace WCP {
+
+    /// The wire charges of one time slice, one array per plane as
+    /// taken by SliceImager::process().
+    struct SliceFrame {
+	long slice;
+	const float* charge[3];	// U, V and Y
+    };
+
+    /** WCP::SliceExecutor - image batches of time slices on a pool
+	of threads.
+
+	The threads are started once and wait between batches.  Each
+	has its own SliceImager on the shared, read only tiling.  A
+	batch is split into one contiguous range of slices per thread.
+	A thread takes slices from the front of its range and, when
+	it runs dry, steals the back half of the range of another, so
+	busy slices do not leave threads idle.  The calling thread
+	works too.
+
+	Results are written in slice order into a vector owned by the
+	caller, whose buffers are reused from batch to batch.  The
+	first exception thrown while imaging is rethrown from
+	process() once all threads have stopped.
+     */
+    class SliceExecutor {
+    public:
+	/// Make a pool of nthreads threads, zero for one per hardware
+	/// thread, imaging with the given threshold.
+	SliceExecutor(const TileMaker& tiling, const CellCoincidence& coincidence,
+		      int nthreads = 0, float threshold = 0.0);
+	~SliceExecutor();
+
+	/// Number of threads, including the calling one.
+	int nthreads() const { return workers.size(); }
+
+	/// Image every frame, results[i] receiving frames[i].
+	void process(const std::vector<SliceFrame>& frames, std::vector<SliceCells>& results);
+
+	/// Number of ranges stolen during the last batch.
+	long steals() const { return numSteals; }
+
+    private:
+	struct Worker;
+
+	void run(int id);
+	void work(int id);
+	bool take(Worker& worker, int& ind);
+	bool steal(int id);
+
+	std::vector<std::unique_ptr<Worker> > workers;
+	std::vector<std::thread> threads;
+
+	// The current batch
+	const std::vector<SliceFrame>* frames;
+	std::vector<SliceCells>* results;
+	std::atomic<int> remaining;
+	std::atomic<long> numSteals;
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	// Starting and finishing batches
+	std::mutex poolMutex;
+	std::condition_variable startBatch, endBatch;
+	long generation;
+	int active;
+	bool stopping;
+    };
+
+}
+#endif
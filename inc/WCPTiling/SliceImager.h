@@ -0,0 +1,82 @@
+#ifndef WIRECELL_SLICEIMAGER_H
+#define WIRECELL_SLICEIMAGER_H
+
+#include "WCPTiling/TileMaker.h"
+#include "WCPTiling/CellCoincidence.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace WCP {
+
+    /// The cells imaged in one time slice.
+    struct SliceCells {
+	long slice;			// number of the time slice
+	std::vector<int> cells;		// IDs of cells whose three wires fired
+	std::vector<float> wireCharge;	// U, V and Y wire charge of each cell
+
+	SliceCells() : slice(-1) {}
+
+	/// Number of cells.
+	size_t size() const { return cells.size(); }
+
+	/// Empty the slice, keeping the capacity of the buffers.
+	void clear() { cells.clear(); wireCharge.clear(); }
+    };
+
+    /** WCP::SliceImager - image a stream of time slices against one
+	tiling.
+
+	Each slice is a frame of wire charges, one array per plane
+	indexed by wire index in the plane.  A wire fires if its
+	charge is above the threshold, and the cells whose three wires
+	fired are found with a CellCoincidence.  The fired wire
+	bitsets and the cell buffers are sized when the imager is made
+	and reused for every slice, so once the cell buffers have
+	grown to the busiest slice seen, processing a slice does not
+	allocate.
+
+	An imager is scratch space for one thread.  The tiling and
+	the coincidence engine may be shared by many imagers.
+     */
+    class SliceImager {
+    public:
+	/// Make an imager, with room for cellCapacity cells per slice
+	/// before its buffers grow.
+	SliceImager(const TileMaker& tiling, const CellCoincidence& coincidence,
+		    float threshold = 0.0, size_t cellCapacity = 1 << 16);
+	~SliceImager();
+
+	/// Number of charges expected in a frame for the plane.
+	int nwires(WirePlaneType_t plane) const { return coincidence.nwires(plane); }
+
+	/// Image one slice from the wire charges of each plane.  The
+	/// result is valid until the next call.
+	const SliceCells& process(long slice, const float* Ucharge, const float* Vcharge,
+				  const float* Ycharge);
+
+	/// Image one slice into a result owned by the caller, whose
+	/// buffers are reused.
+	void process(long slice, const float* Ucharge, const float* Vcharge, const float* Ycharge,
+		     SliceCells& result);
+
+	/// The result of the last call to process() returning one.
+	const SliceCells& result() const { return current; }
+
+	/// Number of slices processed.
+	long nslices() const { return numSlices; }
+
+    private:
+	void fire(const float* charge, int nwires, uint64_t* bits) const;
+
+	const CellStore& store;
+	const CellCoincidence& coincidence;
+	float threshold;
+	std::vector<uint64_t> fired[3];
+	SliceCells current;
+	long numSlices;
+    };
+
+}
+#endif
@@ -0,0 +1,24 @@
+#ifndef WIRECELL_SYNTHETICGEOMETRY_H
+#define WIRECELL_SYNTHETICGEOMETRY_H
+
+#include "WCPNav/GeomDataSource.h"
+#include "WCPData/GeomWire.h"
+
+namespace WCP {
+
+    /// Add the wires of a plane at angle (from the Y axis) and pitch
+    /// covering a height x width active area to gds, numbering them
+    /// from ident.  Returns the next free ident.  U wire 0 passes
+    /// through the top and V wire 0 through the bottom of the first
+    /// Y wire, as TileMaker assumes.
+    int addSyntheticPlane(GeomDataSource& gds, WirePlaneType_t plane, double angle, double pitch,
+			  double height, double width, int ident);
+
+    /// Fill gds with numYwires Y wires and the U and V wires at
+    /// +angle and -angle, all at the same pitch, over an active area
+    /// of the given height.  This is the geometry TilingBenchmark
+    /// sweeps over and the tests tile.
+    void makeSyntheticGeometry(GeomDataSource& gds, int numYwires, double angle, double pitch, double height);
+
+}
+#endif
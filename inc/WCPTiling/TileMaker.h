@@ -2,13 +2,102 @@
 #define WIRECELL_TILEMAKER_H
 
 #include "WCPTiling/TilingBase.h"
+#include "WCPTiling/CellStore.h"
+#include "WCPTiling/CellWireIndex.h"
+#include "WCPTiling/WireTripleIndex.h"
+#include "WCPTiling/CellGraph.h"
+#include "WCPTiling/TilingCache.h"
+#include "WCPTiling/CountingAllocator.h"
+#include "WCPTiling/CellPolygon.h"
+#include "WCPTiling/CrossingKernel.h"
 
 #include "WCPNav/GeomDataSource.h"
 
 #include "WCPData/GeomWCPMap.h"
 
+#include <string>
+#include <mutex>
+
 namespace WCP {
 
+    /// Options controlling how a TileMaker builds its tiling.
+    struct TileMakerOptions {
+	TileMakerOptions();
+
+	/// Number of threads used to construct cell chains.  One
+	/// builds serially, zero uses every hardware thread.  The
+	/// resulting cells and their IDs do not depend on this.
+	int nthreads;
+
+	/// If true, the range of V crossings forming a cell with each
+	/// U crossing is computed in closed form from the wire
+	/// geometry.  If false every U/V pair along a chain is tested
+	/// with formsCell until the run of cells ends.  Both give the
+	/// same cells.
+	bool analyticCrossings;
+
+	/// If not empty, a directory holding tiling cache files.  A
+	/// tiling is mapped from the file matching the geometry's
+	/// fingerprint if there is one, else it is constructed and
+	/// saved there for the next time.
+	std::string cacheDirectory;
+
+	/// If true and the U and V crossings repeat every few Y wires,
+	/// only the chains of one period and those at the left and
+	/// right edges are constructed.  The others are copies moved
+	/// along Z.  Copied cells have the wire indices, vertex count
+	/// and vertex order of constructed ones, and their vertices,
+	/// centers and areas agree to within rounding.
+	bool periodicity;
+
+	/// If true, cells which are translated copies of one another
+	/// share their vertices and area through a table of shapes in
+	/// the cell store, see CellStore::compact().
+	bool compactCells;
+
+	/// If true, progress is reported on std::cerr.
+	bool verbose;
+
+	/// If true, time vertex computation and edge trimming per
+	/// cell.  This adds clock reads to the innermost loop.
+	bool profile;
+    };
+
+    /** Timing and counts gathered while a TileMaker builds its
+	tiling.  Times are wall clock seconds.  The vertex and trim
+	times are only filled when profiling and are summed over all
+	threads, the other phases are elapsed time.
+     */
+    struct TileMakerStats {
+	TileMakerStats();
+	TileMakerStats& operator+=(const TileMakerStats& other);
+
+	double setupTime;	// geometry reading and cache lookup
+	double chainTime;	// building all cell chains
+	double vertexTime;	// computing cell vertices, less trimming
+	double trimTime;	// trimming cells at the edges
+	double storeTime;	// numbering and storing cells
+	double wireMapTime;	// filling the wire-cell index and triple hash
+	double compactTime;	// moving cells into the shape table
+	double cacheTime;	// saving the tiling cache
+	double totalTime;
+
+	long formsCellCalls;	// U/V pairs tested
+	long formsCellAccepts;	// pairs forming a cell
+	long cellsDiscarded;	// cells left with fewer than three vertices
+	long cellsTrimmed;	// cells trimmed at an edge of the active area
+	long cellsSorted;	// degenerate cells whose vertices were sorted by angle
+	long allocations;	// heap allocations made growing cell chains
+	long period;		// Y wires per repeat of the chains, 0 if none was used
+	long chainsReplicated;	// chains copied from an earlier period
+    };
+
+    /// A cell crossed by a line segment.
+    struct CellCrossing {
+	int cell;		// cell ID
+	double length;		// length of the segment inside the cell
+    };
+
     /** WCPTiling::TileMaker - tiling using Michael Mooney's algorithm.
 
 	This class is a transliterated copy of the tile generation
@@ -16,7 +105,8 @@ namespace WCP {
      */
     class TileMaker : public TilingBase { 
     public:
-	TileMaker(const WCP::GeomDataSource& geom);
+	TileMaker(const WCP::GeomDataSource& geom,
+		  const TileMakerOptions& options = TileMakerOptions());
 	virtual ~TileMaker();
 
 	// base API
@@ -28,18 +118,92 @@ namespace WCP {
 	GeomCellSelection cells(const GeomWire& wire) const;
 
 	/// Returns the one cell associated with the collection of wires or 0.
-	virtual GeomCell* cell(const GeomWireSelection& wires) const;
+	virtual const GeomCell* cell(const GeomWireSelection& wires) const;
+
+	/// Number of U/V crossing pairs tested with formsCell while
+	/// constructing the cells.
+	long candidatePairs() const { return buildStats.formsCellCalls; }
+
+	/// Timing and counts from building the tiling.
+	const TileMakerStats& stats() const { return buildStats; }
+
+	/// True if the tiling was mapped from a cache file.
+	bool fromCache() const { return cache.isOpen(); }
+
+	/// Access the flat store of cells.  Cell IDs index into it.
+	const CellStore& cellStore() const { return store; }
+
+	/// Access the cell/wire adjacency of the tiling.
+	const CellWireIndex& cellWireIndex() const { return index; }
+
+	/// Access the (U,V,Y) wire triple hash of the tiling.
+	const WireTripleIndex& wireTripleIndex() const { return triples; }
+
+	/// Access the graph of neighboring cells, built on first use.
+	const CellGraph& cellGraph() const;
+
+	/// The ID of the cell formed by the wires with the given
+	/// in-plane indices or -1.
+	int cellID(int uindex, int vindex, int yindex) const { return triples.find(uindex, vindex, yindex); }
+
+	/// Batched cellID() over n triples given as parallel arrays.
+	void cellIDs(size_t n, const int* uindex, const int* vindex, const int* yindex, int* ids) const {
+	    triples.find(n, uindex, vindex, yindex, ids);
+	}
+
+	/// The GeomCell view of the cell with the given ID or 0.
+	const GeomCell* geomCell(int ident) const;
+
+	/// The ID of the cell containing the point (Y,Z) or -1.  The
+	/// nearest wire of each plane is found by arithmetic and the
+	/// cell through the wire triple hash.  A point on the boundary
+	/// of two cells, to within a nanometer, is given to one of
+	/// them.
+	int locate(double Yval, double Zval) const;
+
+	/// Batched locate() over n points given as parallel arrays.
+	void locate(size_t n, const double* Yval, const double* Zval, int* ids) const;
+
+	/// Append to crossed the cells crossed by the segment from
+	/// (Y1,Z1) to (Y2,Z2), in order from the first point, with
+	/// the length of the segment inside each.  The segment is
+	/// walked across the strips of the three planes, crossing one
+	/// strip edge per step, and each stretch between edges is
+	/// given to the cell of its wire triple.  Stretches outside
+	/// every cell, and those shorter than a nanometer where the
+	/// segment passes through a corner, are skipped.  Returns the
+	/// number of cells appended.
+	size_t traverse(double Y1, double Z1, double Y2, double Z2,
+			std::vector<CellCrossing>& crossed) const;
+
+	/// Batched traverse() over n segments given as parallel
+	/// arrays.  Crossed is refilled, the cells crossed by segment
+	/// i being [offsets[i],offsets[i+1]) of the n+1 offsets.
+	void traverse(size_t n, const double* Y1, const double* Z1, const double* Y2, const double* Z2,
+		      std::vector<CellCrossing>& crossed, size_t* offsets) const;
 
     private:
+	// The tests check steps of chain construction directly
+	friend struct TileMakerProbe;
 
 	// Our connection to the wire geometry
 	const GeomDataSource& geo;
-	// What we make
-	GeomCellSet cellset;
-	GeomWireMap wiremap;
-	GeomCellMap cellmap;
+	TileMakerOptions opts; //!
+	// What we make.  The cells live in the flat store, which may
+	// be a view of a mapped cache.  The GeomCells are views on the
+	// cells, in ID order, made on first use by the base API.  The
+	// neighbor graph is also made on first use.
+	TilingCache cache; //!
+	CellStore store; //!
+	CellWireIndex index; //!
+	WireTripleIndex triples; //!
+	mutable std::vector<GeomCell> cellviews; //!
+	mutable std::once_flag cellviewsOnce; //!
+	mutable CellGraph graph; //!
+	mutable std::once_flag graphOnce; //!
 	
-	// Cache some values between methods
+	// Cache some values between methods.  Wires are held in order
+	// of their index in the plane.
 	GeomWireSelection Uwires;
 	GeomWireSelection Vwires;
 	GeomWireSelection Ywires;
@@ -50,16 +214,51 @@ namespace WCP {
 	double firstYwireUoffsetYval, firstYwireVoffsetYval;
 	double leftEdgeOffsetZval, rightEdgeOffsetZval;
 	double UspacingOnWire, VspacingOnWire;
+	double crossingHalfWidth;
+	int candidateSlot[CrossingBatch::kNumCandidates];
+	double activeArea[4];
+	// The fractional index of the nearest wire of each plane to a
+	// point is [0]*Z + [1]*Y + [2], and [3] is the locate tolerance
+	// in units of the index.
+	double wireCoordinate[3][4];
+	TileMakerStats buildStats; //!
+
+	// The cells made by one chain, before they are given their
+	// IDs.  Cell i has vertices [vertexOffset[i], vertexOffset[i+1]).
+	// Buffers grow per chain, building a cell does not allocate.
+	typedef std::vector<int, CountingAllocator<int> > ChainIntVector;
+	struct CellChain {
+	    std::vector<CellPolygon::Vertex, CountingAllocator<CellPolygon::Vertex> > vertices;
+	    ChainIntVector vertexOffset;
+	    ChainIntVector uindex, vindex, yindex;
+	    int size() const { return uindex.size(); }
+	};
 
 	void constructCells();
-	void constructCellChain(double wireZval, double YvalOffsetU, double YvalOffsetV);
-	void constructCell(double YwireZval, double UwireYval, double VwireYval);
-	bool formsCell(double UwireYval, double VwireYval);
-	std::vector<std::pair<double,double> > getCellVertices(double YwireZval, double UwireYval, double VwireYval);
-
-	int getUwireID(double Yval, double Zval);
-	int getVwireID(double Yval, double Zval);
-	int getYwireID(double Zval);
+	bool loadCache(const std::string& path, uint64_t fingerprint);
+	bool saveCache(const std::string& path, uint64_t fingerprint) const;
+	const std::vector<GeomCell>& geomCells() const;
+	void chainOffsets(int ind, double& Zval, double& Uoffset, double& Voffset) const;
+	int chainPeriod() const;
+	bool edgeChain(int ind) const;
+	void replicateChain(const CellChain& from, int shift, CellChain& chain) const;
+	void constructCellChain(double wireZval, double YvalOffsetU, double YvalOffsetV, CellChain& chain, TileMakerStats& chainStats) const;
+	bool crossingRange(double UwireYval, double YvalOffsetV, int numVcrosses, int& indVmin, int& indVmax) const;
+	void constructBatch(const CrossingStrip& strip, CrossingBatch& batch, CellChain& chain, TileMakerStats& chainStats) const;
+	void storeCellChain(const CellChain& chain);
+	bool formsCell(double UwireYval, double VwireYval) const;
+	void getCellVertices(const CrossingBatch& batch, int ind, CellPolygon& cell, TileMakerStats& chainStats) const;
+
+	int getUwireID(double Yval, double Zval) const;
+	int getVwireID(double Yval, double Zval) const;
+	int getYwireID(double Zval) const;
+	bool nearestWires(double Yval, double Zval, int* windex, int* wother) const;
+	bool cellContains(int ident, double Yval, double Zval) const;
+	int locateNear(double Yval, double Zval, const int* windex, const int* wother) const;
+	template <class Stretch>
+	void walkSegment(double Y1, double Z1, double Y2, double Z2, Stretch stretch) const;
+
+	const GeomWireSelection& planeWires(WirePlaneType_t plane) const;
 
 
     };
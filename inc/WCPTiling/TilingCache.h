@@ -0,0 +1,149 @@
+#ifndef WIRECELL_TILINGCACHE_H
+#define WIRECELL_TILINGCACHE_H
+
+#include "WCPTiling/FlatArray.h"
+
+#include "WCPNav/GeomDataSource.h"
+
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+namespace WCP {
+
+    /** A tiling cache file is a fixed header followed by a sequence
+	of arrays.  Each array is a 64 bit element count then the raw
+	elements, padded to a multiple of 8 bytes so that every array
+	in a mapped file is suitably aligned.  The file is only read
+	back on a machine of the same byte order, which the header
+	records.
+     */
+    struct TilingCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteorder;
+	uint64_t fingerprint;
+	uint64_t size;
+    };
+
+    /// Sequentially write arrays to a new tiling cache file.
+    class TilingCacheWriter {
+    public:
+	TilingCacheWriter();
+	~TilingCacheWriter();
+
+	/// Start a cache file for the fingerprint.  It is written
+	/// under a temporary name and only appears at path once
+	/// commit() succeeds, so concurrent writers and readers never
+	/// see a partial file.
+	bool open(const std::string& path, uint64_t fingerprint);
+
+	template<typename T>
+	void write(const FlatArray<T>& arr) { write(arr.data(), arr.size()); }
+
+	template<typename T>
+	void write(const T* data, size_t n) {
+	    const uint64_t count = n;
+	    put(&count, sizeof(count));
+	    put(data, n*sizeof(T));
+	}
+
+	/// Finish the file and move it into place.
+	bool commit();
+
+    private:
+	TilingCacheWriter(const TilingCacheWriter&);
+	TilingCacheWriter& operator=(const TilingCacheWriter&);
+
+	void put(const void* data, size_t nbytes);
+
+	std::FILE* fp;
+	std::string path, tmppath;
+	TilingCacheHeader header;
+	bool ok;
+    };
+
+    /// Sequentially read arrays from a mapped tiling cache without
+    /// copying them.
+    class TilingCacheReader {
+    public:
+	TilingCacheReader(const char* begin = 0, const char* end = 0);
+
+	/// Point arr at the next array in the cache.  Returns false
+	/// if the cache is exhausted or holds a mismatched array.
+	template<typename T>
+	bool read(FlatArray<T>& arr) {
+	    const T* data = 0;
+	    size_t n = 0;
+	    if (!next(sizeof(T), reinterpret_cast<const char**>(&data), n)) {
+		return false;
+	    }
+	    arr.attach(data, n);
+	    return true;
+	}
+
+	/// Copy the next array, which must hold exactly n elements, to data.
+	template<typename T>
+	bool read(T* data, size_t n) {
+	    const T* mapped = 0;
+	    size_t count = 0;
+	    if (!next(sizeof(T), reinterpret_cast<const char**>(&mapped), count) || count != n) {
+		return false;
+	    }
+	    for (size_t ind = 0; ind < n; ++ind) {
+		data[ind] = mapped[ind];
+	    }
+	    return true;
+	}
+
+    private:
+	bool next(size_t elsize, const char** data, size_t& n);
+
+	const char* cursor;
+	const char* end;
+    };
+
+    /** WCP::TilingCache - a read only memory mapping of a tiling
+	cache file, valid for as long as this object lives.
+     */
+    class TilingCache {
+    public:
+	/// Bump whenever the layout of the cache or the tiling
+	/// algorithm changes.
+	static const uint32_t version = 4;
+
+	TilingCache();
+	~TilingCache();
+
+	/// A hash of the wire geometry a TileMaker reads from geo and
+	/// of the options bits which change the cells it stores, so
+	/// tilings built differently never share a cache file.
+	static uint64_t fingerprint(const GeomDataSource& geo, uint32_t options = 0);
+
+	/// The cache file name for a fingerprint in a directory.
+	static std::string filename(const std::string& directory, uint64_t fingerprint);
+
+	/// Map the file at path.  Returns false, leaving nothing
+	/// mapped, if it does not exist or was not written by this
+	/// version for this fingerprint.
+	bool open(const std::string& path, uint64_t fingerprint);
+
+	/// Unmap the file.
+	void close();
+
+	bool isOpen() const { return mem != 0; }
+
+	/// A reader positioned at the first array.
+	TilingCacheReader reader() const;
+
+    private:
+	TilingCache(const TilingCache&);
+	TilingCache& operator=(const TilingCache&);
+
+	const char* mem;
+	size_t memsize;
+    };
+
+}
+#endif
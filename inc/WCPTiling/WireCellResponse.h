@@ -0,0 +1,88 @@
+#ifndef WIRECELL_WIRECELLRESPONSE_H
+#define WIRECELL_WIRECELLRESPONSE_H
+
+#include "WCPTiling/TileMaker.h"
+
+#include <vector>
+#include <cstddef>
+
+namespace WCP {
+
+    /** WCP::SparseMatrixView - a sparse matrix in compressed sparse
+	row form over arrays held elsewhere.
+
+	Row r has the entries [offset[r], offset[r+1]), entry k being
+	weight[k] in column column[k].  Columns ascend within a row.
+     */
+    struct SparseMatrixView {
+	int nrows, ncols;
+	const int* offset;
+	const int* column;
+	const float* weight;
+
+	SparseMatrixView() : nrows(0), ncols(0), offset(0), column(0), weight(0) {}
+
+	/// Number of entries.
+	int nnz() const { return nrows ? offset[nrows] - offset[0] : 0; }
+
+	/// Write the row of each entry to rows, which with column and
+	/// weight gives the matrix in coordinate (COO) form.
+	void expandRows(int* rows) const;
+    };
+
+    /// The response restricted to a subset of cells.  Its buffers
+    /// are reused by each WireCellResponse::select() into it.
+    struct WireCellSubset {
+	std::vector<int> cells;		// local column -> cell ID
+	std::vector<int> wires;		// local row -> global wire number
+	std::vector<int> wireOffset, wireCells;
+	std::vector<int> cellOffset, cellWires;
+	std::vector<float> weight;	// all entries, for both views
+	// Scratch
+	std::vector<int> wireLocal;	// global wire -> local row or -1
+	std::vector<int> rowFill;
+
+	/// Wires by cells, in local numbering.
+	SparseMatrixView byWire() const;
+
+	/// Cells by wires, the transpose of byWire().
+	SparseMatrixView byCell() const;
+    };
+
+    /** WCP::WireCellResponse - the linear map from cell charges to
+	wire charges of a tiling.
+
+	The charge of a cell is seen in full by each of its U, V and Y
+	wires, so the response has a weight of one for every wire and
+	cell which share an edge in the tiling's CellWireIndex.  Rows
+	are wires in the index's global numbering and columns are
+	cell IDs.  The full response views the index's arrays without
+	copying them.  A subset of cells, such as those which fired in
+	a time slice, gives a small response in local numbering.
+
+	The response refers to the tiling, which must outlive it, and
+	may be shared by any number of threads.
+     */
+    class WireCellResponse {
+    public:
+	explicit WireCellResponse(const TileMaker& tiling);
+	~WireCellResponse();
+
+	/// Every wire by every cell.
+	SparseMatrixView full() const;
+
+	/// Restrict the response to n cells, which become the local
+	/// columns in the order given.  The local rows are the wires
+	/// of those cells in order of first use.
+	void select(const int* cells, size_t n, WireCellSubset& subset) const;
+
+	/// Approximate number of bytes held, besides the viewed index.
+	size_t memory() const { return ones.capacity()*sizeof(float); }
+
+    private:
+	const CellWireIndex& index;
+	std::vector<float> ones;
+    };
+
+}
+#endif
@@ -0,0 +1,70 @@
+#ifndef WIRECELL_WIRETRIPLEINDEX_H
+#define WIRECELL_WIRETRIPLEINDEX_H
+
+#include "WCPTiling/CellStore.h"
+#include "WCPTiling/FlatArray.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace WCP {
+
+    /** WCP::WireTripleIndex - hash from a (U,V,Y) wire index triple
+	to the ID of the cell those wires form.
+
+	The three in-plane wire indices are packed into one 64 bit
+	key, 21 bits each, offset so that the slightly negative
+	indices of corner cells are kept.  Keys live in an open
+	addressing table with linear probing and a load factor of at
+	most one half, so a lookup touches one or two cache lines.
+
+	The table is built once and then read only, so it may be
+	queried from any number of threads.
+     */
+    class WireTripleIndex {
+    public:
+	WireTripleIndex();
+	~WireTripleIndex();
+
+	/// (Re)build the table from the cells in the store.
+	void build(const CellStore& store);
+
+	/// The ID of the cell formed by the wires or -1.
+	int find(int uindex, int vindex, int yindex) const;
+
+	/// Look up n triples given as three parallel arrays, writing
+	/// the cell IDs (or -1) to cells.
+	void find(size_t n, const int* uindex, const int* vindex, const int* yindex,
+		  int* cells) const;
+
+	/// Number of cells in the table.
+	int size() const { return ncells; }
+
+	/// Approximate number of bytes held by the table.
+	size_t memory() const;
+
+	/// Append the table to a tiling cache.
+	void save(TilingCacheWriter& out) const;
+
+	/// Make the table a view of one in a mapped tiling cache.
+	bool load(TilingCacheReader& in);
+
+	/// Pack a triple into a key.  Returns the empty key if an
+	/// index does not fit.
+	static uint64_t pack(int uindex, int vindex, int yindex);
+
+	/// A key which no triple packs to.
+	static const uint64_t emptyKey = ~uint64_t(0);
+
+    private:
+	size_t slot(uint64_t key) const;
+
+	FlatArray<uint64_t> slotKey;
+	FlatArray<int> slotCell;
+	size_t mask;
+	int ncells;
+    };
+
+}
+#endif
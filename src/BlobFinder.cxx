@@ -0,0 +1,97 @@
+#include "WCPTiling/BlobFinder.h"
+#include "WCPTiling/ParallelFor.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+// Lists are joined in chunks of this many cells, and lists of fewer
+// than one chunk per thread are joined in the calling thread.
+static const int chunkCells = 4096;
+
+BlobFinder::BlobFinder(const TileMaker& tiling, int nthreads)
+    : graph(tiling.cellGraph())
+    , nthreads(nthreads)
+    , local(tiling.cellGraph().ncells(), -1)
+    , capacity(0)
+{
+}
+
+BlobFinder::~BlobFinder()
+{
+}
+
+// Follow the parents to the root, halving the path on the way.
+// Parents only ever move to earlier positions, so a stale halving
+// is harmless.
+int BlobFinder::root(int ind)
+{
+    while (true) {
+	int up = parent[ind].load(std::memory_order_relaxed);
+	if (up == ind) {
+	    return ind;
+	}
+	const int upup = parent[up].load(std::memory_order_relaxed);
+	if (upup != up) {
+	    parent[ind].compare_exchange_weak(up, upup, std::memory_order_relaxed);
+	}
+	ind = up;
+    }
+}
+
+void BlobFinder::unite(int ind1, int ind2)
+{
+    while (true) {
+	ind1 = root(ind1);
+	ind2 = root(ind2);
+	if (ind1 == ind2) {
+	    return;
+	}
+	if (ind1 < ind2) {
+	    std::swap(ind1, ind2);
+	}
+	// Hang the later root under the earlier one if it still is a root
+	int expected = ind1;
+	if (parent[ind1].compare_exchange_strong(expected, ind2)) {
+	    return;
+	}
+    }
+}
+
+int BlobFinder::find(const int* cells, size_t n, int* labels)
+{
+    if (n > capacity) {
+	parent.reset(new std::atomic<int>[n]);
+	capacity = n;
+    }
+    for (size_t ind = 0; ind < n; ++ind) {
+	local[cells[ind]] = ind;
+	parent[ind].store(ind, std::memory_order_relaxed);
+    }
+
+    // Join each cell with its fired neighbors earlier in the list
+    const int nchunks = (n + chunkCells-1)/chunkCells;
+    const int njoin = nchunks < resolve_nthreads(nthreads) ? 1 : nthreads;
+    parallel_for(nchunks, njoin, [&](int chunk) {
+	const int first = chunk*chunkCells, last = std::min<int>(n, first+chunkCells);
+	for (int ind = first; ind < last; ++ind) {
+	    const int* it = graph.neighborsBegin(cells[ind]);
+	    const int* end = graph.neighborsEnd(cells[ind]);
+	    for (; it != end; ++it) {
+		const int other = local[*it];
+		if (other >= 0 && other < ind) {
+		    unite(ind, other);
+		}
+	    }
+	}
+    });
+
+    // Every root is the first cell of its blob
+    int nblobs = 0;
+    for (size_t ind = 0; ind < n; ++ind) {
+	const int top = root(ind);
+	labels[ind] = top == (int)ind ? nblobs++ : labels[top];
+	local[cells[ind]] = -1;
+    }
+    return nblobs;
+}
@@ -0,0 +1,192 @@
+#include "WCPTiling/CellChargeSolver.h"
+#include "WCPTiling/ParallelFor.h"
+
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+using namespace WCP;
+
+// Problems with fewer response entries are solved in the calling
+// thread, as starting threads would take longer than the solve.
+static const int parallelEntries = 1 << 14;
+
+// A warm started cell starts from at least this fraction of its cold
+// start, as a charge of zero would never move again.
+static const double warmFloor = 1e-3;
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+namespace {
+
+    // Threads meet here between the two products of each iteration.
+    class SpinBarrier {
+    public:
+	explicit SpinBarrier(int nthreads) : count(0), phase(0), nthreads(nthreads) {}
+
+	void wait() {
+	    const int seen = phase.load();
+	    if (count.fetch_add(1) + 1 == nthreads) {
+		count = 0;
+		phase.fetch_add(1);
+		return;
+	    }
+	    while (phase.load() == seen) {
+		std::this_thread::yield();
+	    }
+	}
+
+    private:
+	std::atomic<int> count;
+	std::atomic<int> phase;
+	const int nthreads;
+    };
+
+}
+
+CellChargeSolverOptions::CellChargeSolverOptions()
+    : maxIterations(500)
+    , tolerance(1e-6)
+    , nthreads(1)
+    , warmStart(true)
+{
+}
+
+CellChargeSolverStats::CellChargeSolverStats()
+    : iterations(0), converged(false), residual(0), warmCells(0)
+    , setupTime(0), iterateTime(0), totalTime(0)
+{
+}
+
+CellChargeSolver::CellChargeSolver(const TileMaker& tiling, const CellChargeSolverOptions& options)
+    : index(tiling.cellWireIndex())
+    , response(tiling)
+    , opts(options)
+    , lastCharge(tiling.cellWireIndex().ncells(), 0.0)
+    , lastSolve(tiling.cellWireIndex().ncells(), -1)
+    , numSolves(0)
+{
+}
+
+CellChargeSolver::~CellChargeSolver()
+{
+}
+
+const std::vector<double>& CellChargeSolver::solve(const int* cells, size_t n, const float* Ucharge,
+						   const float* Vcharge, const float* Ycharge)
+{
+    const Clock::time_point start = Clock::now();
+    solveStats = CellChargeSolverStats();
+
+    response.select(cells, n, sub);
+    const SparseMatrixView byWire = sub.byWire(), byCell = sub.byCell();
+    const int nrows = byWire.nrows, ncols = byCell.nrows;
+
+    const float* planeCharge[3] = {Ucharge, Vcharge, Ycharge};
+    b.resize(nrows);
+    double bnorm = 0;
+    for (int row = 0; row < nrows; ++row) {
+	const int wire = sub.wires[row];
+	b[row] = std::max(0.0f, planeCharge[index.plane(wire)][index.index(wire)]);
+	bnorm += b[row]*b[row];
+    }
+
+    // A'b, and the cold start of one update from all ones, A'b/A'A1
+    Atb.resize(ncols);
+    x.resize(ncols);
+    Ax.resize(nrows);
+    for (int row = 0; row < nrows; ++row) {
+	double sum = 0;
+	for (int ind = byWire.offset[row]; ind < byWire.offset[row+1]; ++ind) {
+	    sum += byWire.weight[ind];
+	}
+	Ax[row] = sum;
+    }
+    for (int col = 0; col < ncols; ++col) {
+	double sum = 0, norm = 0;
+	for (int ind = byCell.offset[col]; ind < byCell.offset[col+1]; ++ind) {
+	    sum += byCell.weight[ind]*b[byCell.column[ind]];
+	    norm += byCell.weight[ind]*Ax[byCell.column[ind]];
+	}
+	Atb[col] = sum;
+	x[col] = norm > 0 ? sum/norm : 0;
+
+	const int ident = sub.cells[col];
+	if (opts.warmStart && numSolves > 0 && lastSolve[ident] == numSolves-1) {
+	    x[col] = std::max(lastCharge[ident], warmFloor*x[col]);
+	    ++solveStats.warmCells;
+	}
+    }
+    solveStats.setupTime = seconds_since(start);
+
+    const Clock::time_point iterStart = Clock::now();
+    int nthreads = resolve_nthreads(opts.nthreads);
+    if (byWire.nnz() < parallelEntries) {
+	nthreads = 1;
+    }
+    partial.assign(nthreads, 0.0);
+    SpinBarrier barrier(nthreads);
+
+    // Each thread owns a block of rows of each product.
+    parallel_for(nthreads, nthreads, [&](int ithread) {
+	const int row0 = (long)nrows*ithread/nthreads, row1 = (long)nrows*(ithread+1)/nthreads;
+	const int col0 = (long)ncols*ithread/nthreads, col1 = (long)ncols*(ithread+1)/nthreads;
+	double lastResidual = 0;
+	for (int iter = 0; ; ++iter) {
+	    // Ax and the residual
+	    double resid = 0;
+	    for (int row = row0; row < row1; ++row) {
+		double sum = 0;
+		for (int ind = byWire.offset[row]; ind < byWire.offset[row+1]; ++ind) {
+		    sum += byWire.weight[ind]*x[byWire.column[ind]];
+		}
+		Ax[row] = sum;
+		resid += (sum-b[row])*(sum-b[row]);
+	    }
+	    partial[ithread] = resid;
+	    barrier.wait();
+
+	    // Every thread makes the same decision from the same sum
+	    double residual = 0;
+	    for (int ind = 0; ind < nthreads; ++ind) {
+		residual += partial[ind];
+	    }
+	    const bool converged = iter > 0 && std::abs(lastResidual-residual) <= opts.tolerance*lastResidual;
+	    if (converged || iter == opts.maxIterations) {
+		if (ithread == 0) {
+		    solveStats.iterations = iter;
+		    solveStats.converged = converged;
+		    solveStats.residual = bnorm > 0 ? std::sqrt(residual/bnorm) : 0;
+		}
+		break;
+	    }
+	    lastResidual = residual;
+
+	    // x <- x * A'b / A'Ax
+	    for (int col = col0; col < col1; ++col) {
+		double sum = 0;
+		for (int ind = byCell.offset[col]; ind < byCell.offset[col+1]; ++ind) {
+		    sum += byCell.weight[ind]*Ax[byCell.column[ind]];
+		}
+		x[col] = sum > 0 ? x[col]*Atb[col]/sum : 0;
+	    }
+	    barrier.wait();
+	}
+    });
+    solveStats.iterateTime = seconds_since(iterStart);
+
+    for (int col = 0; col < ncols; ++col) {
+	lastCharge[sub.cells[col]] = x[col];
+	lastSolve[sub.cells[col]] = numSolves;
+    }
+    ++numSolves;
+    solveStats.totalTime = seconds_since(start);
+    return x;
+}
@@ -0,0 +1,111 @@
+#include "WCPTiling/CellCoincidence.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+// Bits [first, last] of a word, both in 0..63.
+static uint64_t bitRange(int first, int last)
+{
+    return (~uint64_t(0) << first) & (~uint64_t(0) >> (63-last));
+}
+
+static bool fired(const uint64_t* bits, int index, int nwires)
+{
+    return (unsigned int)index < (unsigned int)nwires && ((bits[index >> 6] >> (index & 63)) & 1);
+}
+
+CellCoincidence::CellCoincidence(const TileMaker& tiling)
+{
+    const CellStore& store = tiling.cellStore();
+    const CellWireIndex& index = tiling.cellWireIndex();
+    numWires[kUwire] = index.nwires(kUwire);
+    numWires[kVwire] = index.nwires(kVwire);
+    numWires[kYwire] = index.nwires(kYwire);
+
+    const int nYwires = numWires[kYwire];
+    firstU.assign(nYwires, 0);
+    yTable.assign(nYwires+1, 0);
+    cellV.reserve(index.ncells());
+    cellID.reserve(index.ncells());
+    std::vector<std::pair<std::pair<int,int>,int> > order;
+    for (int ywire = 0; ywire < nYwires; ++ywire) {
+	const int wire = index.wire(kYwire, ywire);
+	order.clear();
+	for (const int* it = index.cellsBegin(wire); it != index.cellsEnd(wire); ++it) {
+	    order.push_back(std::make_pair(std::make_pair(store.uindex(*it), store.vindex(*it)), *it));
+	}
+	// Chains are built in this order already
+	if (!std::is_sorted(order.begin(), order.end())) {
+	    std::sort(order.begin(), order.end());
+	}
+
+	if (!order.empty()) {
+	    const int umin = order.front().first.first, umax = order.back().first.first;
+	    firstU[ywire] = umin;
+	    size_t ind = 0;
+	    for (int uwire = umin; uwire <= umax+1; ++uwire) {
+		uTable.push_back(cellID.size() + ind);
+		while (ind < order.size() && order[ind].first.first == uwire) {
+		    ++ind;
+		}
+	    }
+	    for (ind = 0; ind < order.size(); ++ind) {
+		cellV.push_back(order[ind].first.second);
+		cellID.push_back(order[ind].second);
+	    }
+	}
+	yTable[ywire+1] = uTable.size();
+    }
+}
+
+CellCoincidence::~CellCoincidence()
+{
+}
+
+size_t CellCoincidence::find(const uint64_t* Ufired, const uint64_t* Vfired, const uint64_t* Yfired,
+			     std::vector<int>& cells) const
+{
+    const size_t start = cells.size();
+    const int nUwires = numWires[kUwire], nVwires = numWires[kVwire], nYwires = numWires[kYwire];
+
+    for (int yword = 0; yword < (nYwires+63)/64; ++yword) {
+	uint64_t ybits = Yfired[yword];
+	if (64*yword+63 >= nYwires) {
+	    ybits &= bitRange(0, (nYwires-1) & 63);
+	}
+	while (ybits) {
+	    const int ywire = 64*yword + __builtin_ctzll(ybits);
+	    ybits &= ybits-1;
+	    if (yTable[ywire] == yTable[ywire+1]) {
+		continue;
+	    }
+
+	    // Walk the fired U wires crossing this Y wire
+	    const int* table = uTable.data() + yTable[ywire] - firstU[ywire];
+	    const int umin = std::max(firstU[ywire], 0);
+	    const int umax = std::min(firstU[ywire] + yTable[ywire+1]-yTable[ywire] - 2, nUwires-1);
+	    for (int uword = umin >> 6; umin <= umax && uword <= umax >> 6; ++uword) {
+		uint64_t ubits = Ufired[uword];
+		ubits &= bitRange(uword == umin >> 6 ? umin & 63 : 0,
+				  uword == umax >> 6 ? umax & 63 : 63);
+		while (ubits) {
+		    const int uwire = 64*uword + __builtin_ctzll(ubits);
+		    ubits &= ubits-1;
+		    for (int pos = table[uwire]; pos < table[uwire+1]; ++pos) {
+			if (fired(Vfired, cellV[pos], nVwires)) {
+			    cells.push_back(cellID[pos]);
+			}
+		    }
+		}
+	    }
+	}
+    }
+    return cells.size() - start;
+}
+
+size_t CellCoincidence::memory() const
+{
+    return sizeof(int)*(firstU.capacity() + yTable.capacity() + uTable.capacity()
+			+ cellV.capacity() + cellID.capacity());
+}
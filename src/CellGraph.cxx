@@ -0,0 +1,149 @@
+#include "WCPTiling/CellGraph.h"
+#include "WCPTiling/ParallelFor.h"
+
+#include <vector>
+#include <algorithm>
+
+using namespace WCP;
+
+namespace {
+
+    // A cell of a Y wire, ordered by U and then V wire index.
+    struct ChainCell {
+	int uindex, vindex, ident;
+	bool operator<(const ChainCell& other) const {
+	    return uindex != other.uindex ? uindex < other.uindex
+		: vindex != other.vindex ? vindex < other.vindex : ident < other.ident;
+	}
+    };
+
+}
+
+// True if the closures of the cells of two wire triples, within one
+// wire of each other in every plane, meet.
+static bool stripsTouch(const StripGeometry& strips, const int* windex1, const int* windex2)
+{
+    int differ[3], ndiffer = 0, same = -1;
+    double edge[3];
+    for (int plane = 0; plane < 3; ++plane) {
+	if (windex1[plane] != windex2[plane]) {
+	    edge[plane] = 0.5*(windex1[plane] + windex2[plane]);
+	    differ[ndiffer++] = plane;
+	}
+	else {
+	    same = plane;
+	}
+    }
+    if (ndiffer < 2) {
+	return true;
+    }
+
+    // Where the edges of the first two differing planes cross
+    const double* wire1 = strips.wire[differ[0]];
+    const double* wire2 = strips.wire[differ[1]];
+    const double det = wire1[0]*wire2[1] - wire1[1]*wire2[0];
+    if (det == 0.0) {
+	return false;
+    }
+    const double rhs1 = edge[differ[0]] - wire1[2], rhs2 = edge[differ[1]] - wire2[2];
+    const double Zval = (rhs1*wire2[1] - wire1[1]*rhs2)/det;
+    const double Yval = (wire1[0]*rhs2 - rhs1*wire2[0])/det;
+
+    const double* area = strips.area;
+    const double tol = strips.tolerance;
+    if (Zval < area[0]-tol || Zval > area[1]+tol || Yval < area[2]-tol || Yval > area[3]+tol) {
+	return false;
+    }
+
+    // The crossing must be on the edge of the third plane if it
+    // differs too, else in the strip the cells share.
+    const int third = ndiffer == 3 ? differ[2] : same;
+    const double* wire3 = strips.wire[third];
+    const double frac = wire3[0]*Zval + wire3[1]*Yval + wire3[2];
+    const double low = ndiffer == 3 ? edge[third] : windex1[third] - 0.5;
+    const double high = ndiffer == 3 ? edge[third] : windex1[third] + 0.5;
+    return frac >= low - wire3[3] && frac <= high + wire3[3];
+}
+
+CellGraph::CellGraph()
+{
+}
+
+CellGraph::~CellGraph()
+{
+}
+
+void CellGraph::build(const CellStore& store, const CellWireIndex& index, const StripGeometry& strips,
+		      int nthreads)
+{
+    const int numCells = store.size();
+    const int nYwires = index.nwires(kYwire);
+    offset.assign(numCells+1, 0);
+    int* offsets = offset.mutable_data();
+
+    // The cells of each Y wire in order
+    std::vector<std::vector<ChainCell> > chains(nYwires);
+    parallel_for(nYwires, nthreads, [&](int ywire) {
+	const int wire = index.wire(kYwire, ywire);
+	std::vector<ChainCell>& chain = chains[ywire];
+	for (const int* it = index.cellsBegin(wire); it != index.cellsEnd(wire); ++it) {
+	    const ChainCell cell = {store.uindex(*it), store.vindex(*it), *it};
+	    chain.push_back(cell);
+	}
+	if (!std::is_sorted(chain.begin(), chain.end())) {
+	    std::sort(chain.begin(), chain.end());
+	}
+    });
+
+    // Neighbors of the cells of each Y wire, in the chain's order,
+    // counted into offsets as they are found.  The candidates are
+    // the cells of this and the next Y wires within one U wire,
+    // found by binary search, and within one V wire.
+    std::vector<std::vector<int> > found(nYwires);
+    parallel_for(nYwires, nthreads, [&](int ywire) {
+	const std::vector<ChainCell>& chain = chains[ywire];
+	std::vector<int>& neighbors = found[ywire];
+	for (size_t ind = 0; ind < chain.size(); ++ind) {
+	    const ChainCell& cell = chain[ind];
+	    const size_t begin = neighbors.size();
+	    const int windex[3] = {cell.uindex, cell.vindex, ywire};
+	    for (int other = std::max(ywire-1, 0); other <= std::min(ywire+1, nYwires-1); ++other) {
+		const std::vector<ChainCell>& near = chains[other];
+		const ChainCell lowest = {cell.uindex-1, cell.vindex-1, -1};
+		std::vector<ChainCell>::const_iterator it = std::lower_bound(near.begin(), near.end(), lowest);
+		for (; it != near.end() && it->uindex <= cell.uindex+1; ++it) {
+		    if (it->ident == cell.ident || it->vindex < cell.vindex-1 || it->vindex > cell.vindex+1) {
+			continue;
+		    }
+		    const int otherIndex[3] = {it->uindex, it->vindex, other};
+		    if (stripsTouch(strips, windex, otherIndex)) {
+			neighbors.push_back(it->ident);
+		    }
+		}
+	    }
+	    std::sort(neighbors.begin()+begin, neighbors.end());
+	    offsets[cell.ident+1] = neighbors.size() - begin;
+	}
+    });
+
+    for (int cell = 0; cell < numCells; ++cell) {
+	offsets[cell+1] += offsets[cell];
+    }
+    neighbor.resize(offsets[numCells]);
+    int* neighbors = neighbor.mutable_data();
+    parallel_for(nYwires, nthreads, [&](int ywire) {
+	const int* from = found[ywire].data();
+	for (size_t ind = 0; ind < chains[ywire].size(); ++ind) {
+	    const int cell = chains[ywire][ind].ident;
+	    const int num = offsets[cell+1] - offsets[cell];
+	    std::copy(from, from+num, neighbors + offsets[cell]);
+	    from += num;
+	}
+	std::vector<int>().swap(found[ywire]);
+    });
+}
+
+size_t CellGraph::memory() const
+{
+    return offset.memory() + neighbor.memory();
+}
@@ -0,0 +1,253 @@
+#include "WCPTiling/CellStore.h"
+#include "WCPTiling/TilingCache.h"
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+using namespace WCP;
+
+CellStore::CellStore()
+{
+    vertexOffset.push_back(0);
+}
+
+CellStore::~CellStore()
+{
+}
+
+int CellStore::add(const std::pair<double,double>* vertices, int nvertices,
+		   const std::pair<double,double>& center, double area,
+		   int uindex, int vindex, int yindex)
+{
+    int ident = Uindex.size();
+
+    if (compacted()) {
+	cellShape.push_back(~(int)cellArea.size());
+    }
+    for (int ind=0; ind<nvertices; ++ind) {
+	vertexZval.push_back(vertices[ind].first);
+	vertexYval.push_back(vertices[ind].second);
+    }
+    vertexOffset.push_back(vertexZval.size());
+
+    centerZval.push_back(center.first);
+    centerYval.push_back(center.second);
+    cellArea.push_back(area);
+    Uindex.push_back(uindex);
+    Vindex.push_back(vindex);
+    Yindex.push_back(yindex);
+
+    return ident;
+}
+
+void CellStore::reserve(size_t ncells, size_t nvertices)
+{
+    vertexOffset.reserve(ncells+1);
+    vertexZval.reserve(nvertices);
+    vertexYval.reserve(nvertices);
+    centerZval.reserve(ncells);
+    centerYval.reserve(ncells);
+    cellArea.reserve(ncells);
+    Uindex.reserve(ncells);
+    Vindex.reserve(ncells);
+    Yindex.reserve(ncells);
+}
+
+void CellStore::clear()
+{
+    vertexOffset.assign(1, 0);
+    vertexZval.clear();
+    vertexYval.clear();
+    centerZval.clear();
+    centerYval.clear();
+    cellArea.clear();
+    Uindex.clear();
+    Vindex.clear();
+    Yindex.clear();
+    cellShape.clear();
+    shapeVertexOffset.clear();
+    shapeVertexZval.clear();
+    shapeVertexYval.clear();
+    shapeArea.clear();
+}
+
+// Hash of a cell's vertices relative to its center, rounded to the
+// tolerance.
+static uint64_t shapeKey(const CellStore& store, int id, double tolerance, std::vector<long long>& coords)
+{
+    const int nvertices = store.nvertices(id);
+    coords.resize(2*nvertices);
+    uint64_t key = nvertices;
+    for (int ind = 0; ind < nvertices; ++ind) {
+	coords[2*ind] = std::llround((store.vertexZ(id, ind) - store.centerZ(id))/tolerance);
+	coords[2*ind+1] = std::llround((store.vertexY(id, ind) - store.centerY(id))/tolerance);
+    }
+    for (size_t ind = 0; ind < coords.size(); ++ind) {
+	key ^= (uint64_t)coords[ind] + 0x9e3779b97f4a7c15ULL + (key << 6) + (key >> 2);
+    }
+    return key;
+}
+
+bool CellStore::compact(double tolerance)
+{
+    if (compacted()) {
+	return true;
+    }
+    const int ncells = size();
+
+    // Group cells by shape.  A hash collision between different
+    // shapes leaves the later cell with a shape of its own.
+    std::unordered_map<uint64_t, int> shapeOf;
+    std::vector<int> candidate(ncells, -1);
+    std::vector<int> firstCell, uses;
+    std::vector<long long> coords, firstCoords;
+    for (int id = 0; id < ncells; ++id) {
+	const uint64_t key = shapeKey(*this, id, tolerance, coords);
+	std::pair<std::unordered_map<uint64_t, int>::iterator, bool> found =
+	    shapeOf.insert(std::make_pair(key, (int)firstCell.size()));
+	if (found.second) {
+	    firstCell.push_back(id);
+	    uses.push_back(0);
+	}
+	else {
+	    shapeKey(*this, firstCell[found.first->second], tolerance, firstCoords);
+	    if (coords != firstCoords) {
+		continue;
+	    }
+	}
+	candidate[id] = found.first->second;
+	++uses[candidate[id]];
+    }
+
+    // Shapes only pay off when shared
+    std::vector<int> shapeIndex(firstCell.size(), -1);
+    int numShapes = 0, numShared = 0;
+    for (size_t ind = 0; ind < firstCell.size(); ++ind) {
+	if (uses[ind] > 1) {
+	    shapeIndex[ind] = numShapes++;
+	    numShared += uses[ind];
+	}
+    }
+    if (numShared < ncells/2) {
+	return false;
+    }
+
+    FlatArray<int> shapes, offset, shapeOffset;
+    FlatArray<double> Zval, Yval, area, shapeZval, shapeYval, sharea;
+    shapes.reserve(ncells);
+    offset.push_back(0);
+    shapeOffset.push_back(0);
+    for (int id = 0; id < ncells; ++id) {
+	const int sh = candidate[id] < 0 ? -1 : shapeIndex[candidate[id]];
+	const int nvert = nvertices(id);
+	if (sh < 0) {
+	    shapes.push_back(~(int)area.size());
+	    for (int ind = 0; ind < nvert; ++ind) {
+		Zval.push_back(vertexZ(id, ind));
+		Yval.push_back(vertexY(id, ind));
+	    }
+	    offset.push_back(Zval.size());
+	    area.push_back(this->area(id));
+	    continue;
+	}
+	shapes.push_back(sh);
+	if (firstCell[candidate[id]] == id) {
+	    for (int ind = 0; ind < nvert; ++ind) {
+		shapeZval.push_back(vertexZ(id, ind) - centerZ(id));
+		shapeYval.push_back(vertexY(id, ind) - centerY(id));
+	    }
+	    shapeOffset.push_back(shapeZval.size());
+	    sharea.push_back(this->area(id));
+	}
+    }
+
+    cellShape.swap(shapes);
+    vertexOffset.swap(offset);
+    vertexZval.swap(Zval);
+    vertexYval.swap(Yval);
+    cellArea.swap(area);
+    shapeVertexOffset.swap(shapeOffset);
+    shapeVertexZval.swap(shapeZval);
+    shapeVertexYval.swap(shapeYval);
+    shapeArea.swap(sharea);
+    return true;
+}
+
+PointVector CellStore::boundary(int id) const
+{
+    PointVector ret;
+    const int nvert = nvertices(id);
+    ret.reserve(nvert);
+    for (int ind=0; ind<nvert; ++ind) {
+	ret.push_back(Point(0, vertexY(id, ind), vertexZ(id, ind)));
+    }
+    return ret;
+}
+
+GeomCell CellStore::geomcell(int id) const
+{
+    return GeomCell(id, boundary(id));
+}
+
+size_t CellStore::memory() const
+{
+    return centerZval.memory() + centerYval.memory()
+	+ Uindex.memory() + Vindex.memory() + Yindex.memory() + cellShape.memory()
+	+ vertexOffset.memory() + vertexZval.memory() + vertexYval.memory() + cellArea.memory()
+	+ shapeVertexOffset.memory() + shapeVertexZval.memory() + shapeVertexYval.memory()
+	+ shapeArea.memory();
+}
+
+void CellStore::save(TilingCacheWriter& out) const
+{
+    out.write(vertexOffset);
+    out.write(vertexZval);
+    out.write(vertexYval);
+    out.write(centerZval);
+    out.write(centerYval);
+    out.write(cellArea);
+    out.write(Uindex);
+    out.write(Vindex);
+    out.write(Yindex);
+    out.write(cellShape);
+    out.write(shapeVertexOffset);
+    out.write(shapeVertexZval);
+    out.write(shapeVertexYval);
+    out.write(shapeArea);
+}
+
+bool CellStore::load(TilingCacheReader& in)
+{
+    bool ok = in.read(vertexOffset) && in.read(vertexZval) && in.read(vertexYval)
+	&& in.read(centerZval) && in.read(centerYval) && in.read(cellArea)
+	&& in.read(Uindex) && in.read(Vindex) && in.read(Yindex)
+	&& in.read(cellShape) && in.read(shapeVertexOffset)
+	&& in.read(shapeVertexZval) && in.read(shapeVertexYval) && in.read(shapeArea);
+
+    const size_t ncells = Uindex.size();
+    const size_t nexplicit = cellArea.size();
+    const size_t nshapes = shapeArea.size();
+    ok = ok && vertexOffset.size() == nexplicit+1
+	&& centerZval.size() == ncells && centerYval.size() == ncells
+	&& Vindex.size() == ncells && Yindex.size() == ncells
+	&& validOffsets(vertexOffset, vertexZval.size())
+	&& vertexYval.size() == vertexZval.size();
+    if (ok && cellShape.empty()) {
+	ok = nexplicit == ncells && nshapes == 0;
+    }
+    else if (ok) {
+	ok = cellShape.size() == ncells && shapeVertexOffset.size() == nshapes+1
+	    && validOffsets(shapeVertexOffset, shapeVertexZval.size())
+	    && shapeVertexYval.size() == shapeVertexZval.size();
+	// Every cell refers to a shape or to one of the explicit cells
+	for (size_t cell = 0; ok && cell < ncells; ++cell) {
+	    const int shape = cellShape[cell];
+	    ok = shape >= 0 ? (size_t)shape < nshapes : (size_t)~shape < nexplicit;
+	}
+    }
+    if (!ok) {
+	clear();
+    }
+    return ok;
+}
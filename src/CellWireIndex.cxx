@@ -0,0 +1,119 @@
+#include "WCPTiling/CellWireIndex.h"
+#include "WCPTiling/TilingCache.h"
+
+using namespace WCP;
+
+CellWireIndex::CellWireIndex()
+{
+    planeOffset[0] = planeOffset[1] = planeOffset[2] = planeOffset[3] = 0;
+    wireCellOffset.push_back(0);
+}
+
+CellWireIndex::~CellWireIndex()
+{
+}
+
+int CellWireIndex::wire(WirePlaneType_t plane, int index) const
+{
+    if (plane < kUwire || plane > kYwire) {
+	return -1;
+    }
+    if (index < 0 || index >= planeOffset[plane+1]-planeOffset[plane]) {
+	return -1;
+    }
+    return planeOffset[plane] + index;
+}
+
+WirePlaneType_t CellWireIndex::plane(int wire) const
+{
+    if (wire < planeOffset[1]) {
+	return kUwire;
+    }
+    if (wire < planeOffset[2]) {
+	return kVwire;
+    }
+    return kYwire;
+}
+
+void CellWireIndex::build(const CellStore& store, int nUwires, int nVwires, int nYwires)
+{
+    planeOffset[0] = 0;
+    planeOffset[1] = nUwires;
+    planeOffset[2] = nUwires + nVwires;
+    planeOffset[3] = nUwires + nVwires + nYwires;
+
+    const int numCells = store.size();
+    const int numWires = planeOffset[3];
+
+    // cell -> wires, while counting cells per wire
+    cellWire.resize(3*numCells);
+    wireCellOffset.assign(numWires+1, 0);
+    int* cellWires = cellWire.mutable_data();
+    int* offsets = wireCellOffset.mutable_data();
+    for (int cell = 0; cell < numCells; ++cell) {
+	int* cw = cellWires + 3*cell;
+	cw[0] = wire(kUwire, store.uindex(cell));
+	cw[1] = wire(kVwire, store.vindex(cell));
+	cw[2] = wire(kYwire, store.yindex(cell));
+	for (int ind = 0; ind < 3; ++ind) {
+	    if (cw[ind] >= 0) {
+		++offsets[cw[ind]+1];
+	    }
+	}
+    }
+    for (int ind = 0; ind < numWires; ++ind) {
+	offsets[ind+1] += offsets[ind];
+    }
+
+    // wire -> cells, filled in cell order so each range ascends
+    wireCell.resize(offsets[numWires]);
+    int* cells = wireCell.mutable_data();
+    std::vector<int> fill(offsets, offsets+numWires);
+    for (int cell = 0; cell < numCells; ++cell) {
+	const int* cw = cellWires + 3*cell;
+	for (int ind = 0; ind < 3; ++ind) {
+	    if (cw[ind] >= 0) {
+		cells[fill[cw[ind]]++] = cell;
+	    }
+	}
+    }
+}
+
+size_t CellWireIndex::memory() const
+{
+    return cellWire.memory() + wireCellOffset.memory() + wireCell.memory();
+}
+
+void CellWireIndex::save(TilingCacheWriter& out) const
+{
+    out.write(planeOffset, 4);
+    out.write(cellWire);
+    out.write(wireCellOffset);
+    out.write(wireCell);
+}
+
+bool CellWireIndex::load(TilingCacheReader& in)
+{
+    bool ok = in.read(planeOffset, 4) && in.read(cellWire)
+	&& in.read(wireCellOffset) && in.read(wireCell);
+
+    ok = ok && planeOffset[0] == 0 && planeOffset[1] >= planeOffset[0]
+	&& planeOffset[2] >= planeOffset[1] && planeOffset[3] >= planeOffset[2]
+	&& cellWire.size() % 3 == 0
+	&& wireCellOffset.size() == (size_t)planeOffset[3]+1
+	&& validOffsets(wireCellOffset, wireCell.size());
+    // Every cell's wire is in its own plane and every wire's cell exists
+    const int numCells = cellWire.size()/3;
+    for (size_t ind = 0; ok && ind < cellWire.size(); ++ind) {
+	const int plane = ind % 3;
+	ok = cellWire[ind] == -1
+	    || (cellWire[ind] >= planeOffset[plane] && cellWire[ind] < planeOffset[plane+1]);
+    }
+    for (size_t ind = 0; ok && ind < wireCell.size(); ++ind) {
+	ok = wireCell[ind] >= 0 && wireCell[ind] < numCells;
+    }
+    if (!ok) {
+	build(CellStore(), 0, 0, 0);
+    }
+    return ok;
+}
@@ -0,0 +1,129 @@
+#include "WCPTiling/ChargeDeposition.h"
+#include "WCPTiling/ParallelFor.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+// Points are located and deposited in blocks of this many, and fewer
+// than one block per thread are deposited in the calling thread.
+static const int depositBlock = 4096;
+
+ChargeDeposition::ChargeDeposition(const TileMaker& tiling, int nthreads)
+    : tiling(tiling)
+    , store(tiling.cellStore())
+    , nthreads(resolve_nthreads(nthreads))
+    , cellTotal(new std::atomic<double>[tiling.cellStore().size()])
+    , cellTouched(new std::atomic<char>[tiling.cellStore().size()])
+    , workers(resolve_nthreads(nthreads))
+    , numPoints(0)
+    , numMissed(0)
+{
+    for (int cell = 0; cell < store.size(); ++cell) {
+	cellTotal[cell].store(0.0, std::memory_order_relaxed);
+	cellTouched[cell].store(0, std::memory_order_relaxed);
+    }
+    const CellWireIndex& index = tiling.cellWireIndex();
+    const WirePlaneType_t planes[3] = {kUwire, kVwire, kYwire};
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	wireTotal[iplane].assign(index.nwires(planes[iplane]), 0.0);
+	for (size_t ind = 0; ind < workers.size(); ++ind) {
+	    workers[ind].wireCharge[iplane].assign(wireTotal[iplane].size(), 0.0);
+	}
+    }
+    for (size_t ind = 0; ind < workers.size(); ++ind) {
+	workers[ind].ids.resize(depositBlock);
+	workers[ind].missed = 0;
+    }
+}
+
+ChargeDeposition::~ChargeDeposition()
+{
+}
+
+size_t ChargeDeposition::deposit(size_t n, const double* Yval, const double* Zval, const float* charge)
+{
+    const int nblocks = (n + depositBlock-1)/depositBlock;
+    const int nworkers = nblocks < nthreads ? 1 : nthreads;
+    const int nwires[3] = {(int)wireTotal[0].size(), (int)wireTotal[1].size(), (int)wireTotal[2].size()};
+
+    std::atomic<int> next(0);
+    parallel_for(nworkers, nworkers, [&](int ithread) {
+	Worker& worker = workers[ithread];
+	int* ids = worker.ids.data();
+	for (int block = next++; block < nblocks; block = next++) {
+	    const size_t first = (size_t)block*depositBlock;
+	    const int num = std::min<size_t>(depositBlock, n-first);
+	    const float* ch = charge + first;
+	    tiling.locate(num, Yval+first, Zval+first, ids);
+
+	    // Consecutive points in one cell are summed first
+	    for (int ind = 0, end = 0; ind < num; ind = end) {
+		const int cell = ids[ind];
+		double sum = 0.0;
+		for (end = ind; end < num && ids[end] == cell; ++end) {
+		    sum += ch[end];
+		}
+		if (cell < 0) {
+		    worker.missed += end - ind;
+		    continue;
+		}
+
+		std::atomic<double>& total = cellTotal[cell];
+		double expected = total.load(std::memory_order_relaxed);
+		while (!total.compare_exchange_weak(expected, expected + sum, std::memory_order_relaxed)) {
+		}
+		if (!cellTouched[cell].load(std::memory_order_relaxed)
+		    && !cellTouched[cell].exchange(1, std::memory_order_relaxed)) {
+		    worker.touched.push_back(cell);
+		}
+
+		const int windex[3] = {store.uindex(cell), store.vindex(cell), store.yindex(cell)};
+		for (int iplane = 0; iplane < 3; ++iplane) {
+		    if (windex[iplane] >= 0 && windex[iplane] < nwires[iplane]) {
+			worker.wireCharge[iplane][windex[iplane]] += sum;
+		    }
+		}
+	    }
+	}
+    });
+
+    // Gather what the threads found, in thread order
+    size_t missed = 0;
+    const size_t before = touched.size();
+    for (int ithread = 0; ithread < nworkers; ++ithread) {
+	Worker& worker = workers[ithread];
+	for (int iplane = 0; iplane < 3; ++iplane) {
+	    double* partial = worker.wireCharge[iplane].data();
+	    double* totals = wireTotal[iplane].data();
+	    for (int wire = 0; wire < nwires[iplane]; ++wire) {
+		totals[wire] += partial[wire];
+		partial[wire] = 0.0;
+	    }
+	}
+	touched.insert(touched.end(), worker.touched.begin(), worker.touched.end());
+	worker.touched.clear();
+	missed += worker.missed;
+	worker.missed = 0;
+    }
+    std::sort(touched.begin()+before, touched.end());
+    std::inplace_merge(touched.begin(), touched.begin()+before, touched.end());
+
+    numPoints += n;
+    numMissed += missed;
+    return missed;
+}
+
+void ChargeDeposition::clear()
+{
+    for (size_t ind = 0; ind < touched.size(); ++ind) {
+	cellTotal[touched[ind]].store(0.0, std::memory_order_relaxed);
+	cellTouched[touched[ind]].store(0, std::memory_order_relaxed);
+    }
+    touched.clear();
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	std::fill(wireTotal[iplane].begin(), wireTotal[iplane].end(), 0.0);
+    }
+    numPoints = 0;
+    numMissed = 0;
+}
@@ -0,0 +1,7 @@
+#include "WCPTiling/CountingAllocator.h"
+
+long& WCP::thread_allocation_count()
+{
+    static thread_local long count = 0;
+    return count;
+}
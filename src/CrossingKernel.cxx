@@ -0,0 +1,237 @@
+#include "WCPTiling/CrossingKernel.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace WCP;
+
+// Every path below evaluates the same expressions in the same order
+// with separate multiplies and adds, so results agree to the bit.
+// Compilers may fuse a scalar multiply and add into one rounding when
+// FMA is enabled, as GCC does by default, so contraction is turned
+// off for this file.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+void WCP::crossingsScalar(const CrossingStrip& strip, CrossingBatch& batch)
+{
+    const double eps = strip.epsilon;
+    const double dZ1 = strip.Z1 - strip.Zval;
+    const double dZ2 = strip.Z2 - strip.Zval;
+    const double Us = strip.Uslope, Vs = strip.Vslope;
+
+    for (int ind = 0; ind < batch.size; ++ind) {
+	const double U[2] = {batch.Uval[ind] - strip.UhalfWidth, batch.Uval[ind] + strip.UhalfWidth};
+	const double V[2] = {batch.Vval[ind] - strip.VhalfWidth, batch.Vval[ind] + strip.VhalfWidth};
+
+	// U/V corners and their bounding box
+	double minZ = 0, maxZ = 0, minY = 0, maxY = 0;
+	for (int iu = 0; iu < 2; ++iu) {
+	    for (int iv = 0; iv < 2; ++iv) {
+		const int k = CrossingBatch::kU1V1 + 2*iu + iv;
+		const double Y = (Vs*U[iu] - Us*V[iv])/(Vs - Us);
+		const double Z = strip.Zval + (Y - U[iu])/Us;
+		batch.Z[k][ind] = Z;
+		batch.Y[k][ind] = Y;
+		if (k == CrossingBatch::kU1V1) {
+		    minZ = maxZ = Z;
+		    minY = maxY = Y;
+		    continue;
+		}
+		if (Z < minZ+eps) minZ = Z;
+		if (Z > maxZ-eps) maxZ = Z;
+		if (Y < minY+eps) minY = Y;
+		if (Y > maxY-eps) maxY = Y;
+	    }
+	}
+	batch.UVminZ[ind] = minZ;
+	batch.UVmaxZ[ind] = maxZ;
+	batch.UVminY[ind] = minY;
+	batch.UVmaxY[ind] = maxY;
+
+	// Y strip edges with U and V strip edges
+	const double slopes[4] = {Us, Us, Vs, Vs};
+	const double intercepts[4] = {U[0], U[1], V[0], V[1]};
+	unsigned int mask = 0;
+	for (int iy = 0; iy < 2; ++iy) {
+	    const double Z = iy ? strip.Z2 : strip.Z1;
+	    const double dZ = iy ? dZ2 : dZ1;
+	    for (int il = 0; il < 4; ++il) {
+		const int k = 4*iy + il;
+		const double Y = slopes[il]*dZ + intercepts[il];
+		batch.Z[k][ind] = Z;
+		batch.Y[k][ind] = Y;
+		// The first candidate has always been accepted up to
+		// epsilon above the box.
+		const double Ymax = (k == CrossingBatch::kY1U1) ? maxY+eps : maxY-eps;
+		if (Y < Ymax && Y > minY+eps && Z < maxZ-eps && Z > minZ+eps) {
+		    mask |= 1u << k;
+		}
+	    }
+	}
+	for (int k = CrossingBatch::kU1V1; k <= CrossingBatch::kU2V2; ++k) {
+	    const double Z = batch.Z[k][ind];
+	    if (Z >= strip.Z1-eps && Z <= strip.Z2+eps) {
+		mask |= 1u << k;
+	    }
+	}
+	batch.mask[ind] = mask;
+    }
+}
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+
+namespace {
+
+#if defined(__AVX512F__)
+    struct Vec {
+	typedef __m512d type;
+	typedef __mmask8 mask;
+	enum { width = 8 };
+	static type load(const double* ptr) { return _mm512_loadu_pd(ptr); }
+	static void store(double* ptr, type val) { _mm512_storeu_pd(ptr, val); }
+	static type set1(double val) { return _mm512_set1_pd(val); }
+	static type add(type a, type b) { return _mm512_add_pd(a, b); }
+	static type sub(type a, type b) { return _mm512_sub_pd(a, b); }
+	static type mul(type a, type b) { return _mm512_mul_pd(a, b); }
+	static type div(type a, type b) { return _mm512_div_pd(a, b); }
+	static mask lt(type a, type b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+	static mask gt(type a, type b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+	static mask le(type a, type b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+	static mask ge(type a, type b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+	static mask both(mask a, mask b) { return a & b; }
+	// b where m is set, else a
+	static type select(mask m, type a, type b) { return _mm512_mask_blend_pd(m, a, b); }
+	static unsigned int bits(mask m) { return m; }
+    };
+    const char* vecName = "avx512";
+#else
+    struct Vec {
+	typedef __m256d type;
+	typedef __m256d mask;
+	enum { width = 4 };
+	static type load(const double* ptr) { return _mm256_loadu_pd(ptr); }
+	static void store(double* ptr, type val) { _mm256_storeu_pd(ptr, val); }
+	static type set1(double val) { return _mm256_set1_pd(val); }
+	static type add(type a, type b) { return _mm256_add_pd(a, b); }
+	static type sub(type a, type b) { return _mm256_sub_pd(a, b); }
+	static type mul(type a, type b) { return _mm256_mul_pd(a, b); }
+	static type div(type a, type b) { return _mm256_div_pd(a, b); }
+	static mask lt(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	static mask gt(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+	static mask le(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+	static mask ge(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+	static mask both(mask a, mask b) { return _mm256_and_pd(a, b); }
+	static type select(mask m, type a, type b) { return _mm256_blendv_pd(a, b, m); }
+	static unsigned int bits(mask m) { return _mm256_movemask_pd(m); }
+    };
+    const char* vecName = "avx2";
+#endif
+
+    typedef Vec::type vec;
+    typedef Vec::mask vmask;
+
+    // Spread the lane bits of a comparison into bit k of each mask.
+    inline void setMaskBit(unsigned int* mask, unsigned int lanes, int k)
+    {
+	for (int lane = 0; lane < Vec::width; ++lane) {
+	    mask[lane] |= ((lanes >> lane) & 1u) << k;
+	}
+    }
+
+}
+
+void WCP::crossings(const CrossingStrip& strip, CrossingBatch& batch)
+{
+    const int nlanes = ((batch.size + Vec::width - 1)/Vec::width)*Vec::width;
+    for (int ind = batch.size; ind < nlanes; ++ind) {
+	batch.Uval[ind] = batch.Uval[0];
+	batch.Vval[ind] = batch.Vval[0];
+    }
+
+    const vec eps = Vec::set1(strip.epsilon);
+    const vec Zval = Vec::set1(strip.Zval);
+    const vec Z1 = Vec::set1(strip.Z1), Z2 = Vec::set1(strip.Z2);
+    const vec dZ[2] = {Vec::set1(strip.Z1 - strip.Zval), Vec::set1(strip.Z2 - strip.Zval)};
+    const vec Us = Vec::set1(strip.Uslope), Vs = Vec::set1(strip.Vslope);
+    const vec dS = Vec::set1(strip.Vslope - strip.Uslope);
+    const vec Uhalf = Vec::set1(strip.UhalfWidth), Vhalf = Vec::set1(strip.VhalfWidth);
+    const vec Z1lo = Vec::sub(Z1, eps), Z2hi = Vec::add(Z2, eps);
+
+    for (int base = 0; base < nlanes; base += Vec::width) {
+	const vec Uc = Vec::load(batch.Uval+base), Vc = Vec::load(batch.Vval+base);
+	const vec U[2] = {Vec::sub(Uc, Uhalf), Vec::add(Uc, Uhalf)};
+	const vec V[2] = {Vec::sub(Vc, Vhalf), Vec::add(Vc, Vhalf)};
+	unsigned int* mask = batch.mask + base;
+	for (int lane = 0; lane < Vec::width; ++lane) {
+	    mask[lane] = 0;
+	}
+
+	vec minZ = Zval, maxZ = Zval, minY = Zval, maxY = Zval;
+	for (int iu = 0; iu < 2; ++iu) {
+	    for (int iv = 0; iv < 2; ++iv) {
+		const int k = CrossingBatch::kU1V1 + 2*iu + iv;
+		const vec Y = Vec::div(Vec::sub(Vec::mul(Vs, U[iu]), Vec::mul(Us, V[iv])), dS);
+		const vec Z = Vec::add(Zval, Vec::div(Vec::sub(Y, U[iu]), Us));
+		Vec::store(batch.Z[k]+base, Z);
+		Vec::store(batch.Y[k]+base, Y);
+		setMaskBit(mask, Vec::bits(Vec::both(Vec::ge(Z, Z1lo), Vec::le(Z, Z2hi))), k);
+		if (k == CrossingBatch::kU1V1) {
+		    minZ = maxZ = Z;
+		    minY = maxY = Y;
+		    continue;
+		}
+		minZ = Vec::select(Vec::lt(Z, Vec::add(minZ, eps)), minZ, Z);
+		maxZ = Vec::select(Vec::gt(Z, Vec::sub(maxZ, eps)), maxZ, Z);
+		minY = Vec::select(Vec::lt(Y, Vec::add(minY, eps)), minY, Y);
+		maxY = Vec::select(Vec::gt(Y, Vec::sub(maxY, eps)), maxY, Y);
+	    }
+	}
+	Vec::store(batch.UVminZ+base, minZ);
+	Vec::store(batch.UVmaxZ+base, maxZ);
+	Vec::store(batch.UVminY+base, minY);
+	Vec::store(batch.UVmaxY+base, maxY);
+
+	const vec Ylo = Vec::add(minY, eps);
+	const vec Zlo = Vec::add(minZ, eps), Zhi = Vec::sub(maxZ, eps);
+	const vec slopes[4] = {Us, Us, Vs, Vs};
+	const vec intercepts[4] = {U[0], U[1], V[0], V[1]};
+	for (int iy = 0; iy < 2; ++iy) {
+	    const vec Z = iy ? Z2 : Z1;
+	    // The Z test is the same for all four lines of a Y edge
+	    const vmask inZ = Vec::both(Vec::lt(Z, Zhi), Vec::gt(Z, Zlo));
+	    for (int il = 0; il < 4; ++il) {
+		const int k = 4*iy + il;
+		const vec Y = Vec::add(Vec::mul(slopes[il], dZ[iy]), intercepts[il]);
+		Vec::store(batch.Z[k]+base, Z);
+		Vec::store(batch.Y[k]+base, Y);
+		const vec Yhi = (k == CrossingBatch::kY1U1) ? Vec::add(maxY, eps) : Vec::sub(maxY, eps);
+		const vmask inY = Vec::both(Vec::lt(Y, Yhi), Vec::gt(Y, Ylo));
+		setMaskBit(mask, Vec::bits(Vec::both(inY, inZ)), k);
+	    }
+	}
+    }
+}
+
+const char* WCP::crossingsInstructionSet()
+{
+    return vecName;
+}
+
+#else
+
+void WCP::crossings(const CrossingStrip& strip, CrossingBatch& batch)
+{
+    crossingsScalar(strip, batch);
+}
+
+const char* WCP::crossingsInstructionSet()
+{
+    return "scalar";
+}
+
+#endif
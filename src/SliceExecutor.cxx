@@ -0,0 +1,178 @@
+#include "WCPTiling/SliceExecutor.h"
+#include "WCPTiling/ParallelFor.h"
+
+#include <cstdint>
+
+using namespace WCP;
+
+// A range [begin,end) of slice indices packed into one word, so that
+// the owner taking from the front and thieves taking from the back
+// can each claim slices with a single compare and swap.
+static uint64_t packRange(uint32_t begin, uint32_t end)
+{
+    return (uint64_t(begin) << 32) | end;
+}
+static uint32_t rangeBegin(uint64_t range) { return range >> 32; }
+static uint32_t rangeEnd(uint64_t range) { return range & 0xffffffff; }
+
+struct SliceExecutor::Worker {
+    Worker(const TileMaker& tiling, const CellCoincidence& coincidence, float threshold)
+	: imager(tiling, coincidence, threshold), range(0) {}
+
+    SliceImager imager;
+    std::atomic<uint64_t> range;
+    // Keep the ranges of different workers on different cache lines
+    char padding[64];
+};
+
+SliceExecutor::SliceExecutor(const TileMaker& tiling, const CellCoincidence& coincidence,
+			     int nthreads, float threshold)
+    : frames(0), results(0), remaining(0), numSteals(0)
+    , generation(0), active(0), stopping(false)
+{
+    nthreads = resolve_nthreads(nthreads);
+    for (int id = 0; id < nthreads; ++id) {
+	workers.push_back(std::unique_ptr<Worker>(new Worker(tiling, coincidence, threshold)));
+    }
+    // Worker 0 is the thread calling process()
+    for (int id = 1; id < nthreads; ++id) {
+	threads.push_back(std::thread(&SliceExecutor::run, this, id));
+    }
+}
+
+SliceExecutor::~SliceExecutor()
+{
+    {
+	std::lock_guard<std::mutex> lock(poolMutex);
+	stopping = true;
+    }
+    startBatch.notify_all();
+    for (size_t ind = 0; ind < threads.size(); ++ind) {
+	threads[ind].join();
+    }
+}
+
+void SliceExecutor::process(const std::vector<SliceFrame>& frames, std::vector<SliceCells>& results)
+{
+    const int nframes = frames.size();
+    results.resize(nframes);
+    if (nframes == 0) {
+	return;
+    }
+
+    this->frames = &frames;
+    this->results = &results;
+    remaining = nframes;
+    numSteals = 0;
+    error = std::exception_ptr();
+    const int nworkers = workers.size();
+    for (int id = 0; id < nworkers; ++id) {
+	workers[id]->range = packRange((long)nframes*id/nworkers, (long)nframes*(id+1)/nworkers);
+    }
+
+    {
+	std::lock_guard<std::mutex> lock(poolMutex);
+	++generation;
+	active = threads.size();
+    }
+    startBatch.notify_all();
+    work(0);
+    {
+	std::unique_lock<std::mutex> lock(poolMutex);
+	endBatch.wait(lock, [this]() { return active == 0; });
+    }
+
+    this->frames = 0;
+    this->results = 0;
+    if (error) {
+	std::rethrow_exception(error);
+    }
+}
+
+void SliceExecutor::run(int id)
+{
+    long seen = 0;
+    while (true) {
+	{
+	    std::unique_lock<std::mutex> lock(poolMutex);
+	    startBatch.wait(lock, [&]() { return stopping || generation != seen; });
+	    if (stopping) {
+		return;
+	    }
+	    seen = generation;
+	}
+	work(id);
+	{
+	    std::lock_guard<std::mutex> lock(poolMutex);
+	    if (--active == 0) {
+		endBatch.notify_one();
+	    }
+	}
+    }
+}
+
+void SliceExecutor::work(int id)
+{
+    Worker& worker = *workers[id];
+    try {
+	while (remaining > 0) {
+	    int ind;
+	    if (!take(worker, ind)) {
+		if (!steal(id)) {
+		    std::this_thread::yield();
+		}
+		continue;
+	    }
+	    const SliceFrame& frame = (*frames)[ind];
+	    worker.imager.process(frame.slice, frame.charge[0], frame.charge[1], frame.charge[2],
+				  (*results)[ind]);
+	    --remaining;
+	}
+    }
+    catch (...) {
+	std::lock_guard<std::mutex> lock(errorMutex);
+	if (!error) {
+	    error = std::current_exception();
+	}
+	// Stop the others taking new slices
+	for (size_t other = 0; other < workers.size(); ++other) {
+	    workers[other]->range = 0;
+	}
+	remaining = 0;
+    }
+}
+
+// Claim the first slice of the worker's own range.
+bool SliceExecutor::take(Worker& worker, int& ind)
+{
+    uint64_t range = worker.range.load();
+    while (rangeBegin(range) < rangeEnd(range)) {
+	if (worker.range.compare_exchange_weak(range, packRange(rangeBegin(range)+1, rangeEnd(range)))) {
+	    ind = rangeBegin(range);
+	    return true;
+	}
+    }
+    return false;
+}
+
+// Move the back half of another worker's range to the empty range of
+// worker id.  Only the owner refills its range, and only when empty,
+// so no thief can be taking from it at the same time.
+bool SliceExecutor::steal(int id)
+{
+    const int nworkers = workers.size();
+    for (int offset = 1; offset < nworkers; ++offset) {
+	Worker& victim = *workers[(id+offset) % nworkers];
+	uint64_t range = victim.range.load();
+	while (rangeBegin(range) < rangeEnd(range)) {
+	    const uint32_t begin = rangeBegin(range), end = rangeEnd(range);
+	    const uint32_t middle = end - (end-begin+1)/2;
+	    if (victim.range.compare_exchange_weak(range, packRange(begin, middle))) {
+		workers[id]->range = packRange(middle, end);
+		++numSteals;
+		return true;
+	    }
+	}
+    }
+    return false;
+}
@@ -0,0 +1,73 @@
+#include "WCPTiling/SliceImager.h"
+
+using namespace WCP;
+
+SliceImager::SliceImager(const TileMaker& tiling, const CellCoincidence& coincidence,
+			 float threshold, size_t cellCapacity)
+    : store(tiling.cellStore())
+    , coincidence(coincidence)
+    , threshold(threshold)
+    , numSlices(0)
+{
+    const WirePlaneType_t planes[3] = {kUwire, kVwire, kYwire};
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	fired[iplane].assign(coincidence.nwords(planes[iplane]), 0);
+    }
+    current.cells.reserve(cellCapacity);
+    current.wireCharge.reserve(3*cellCapacity);
+}
+
+SliceImager::~SliceImager()
+{
+}
+
+// Every word is overwritten, so the bitset needs no clearing.
+void SliceImager::fire(const float* charge, int nwires, uint64_t* bits) const
+{
+    const int nfull = nwires/64;
+    for (int word = 0; word < nfull; ++word) {
+	const float* ch = charge + 64*word;
+	uint64_t mask = 0;
+	for (int bit = 0; bit < 64; ++bit) {
+	    mask |= uint64_t(ch[bit] > threshold) << bit;
+	}
+	bits[word] = mask;
+    }
+    if (nwires % 64) {
+	uint64_t mask = 0;
+	for (int wire = 64*nfull; wire < nwires; ++wire) {
+	    mask |= uint64_t(charge[wire] > threshold) << (wire - 64*nfull);
+	}
+	bits[nfull] = mask;
+    }
+}
+
+const SliceCells& SliceImager::process(long slice, const float* Ucharge, const float* Vcharge,
+				       const float* Ycharge)
+{
+    process(slice, Ucharge, Vcharge, Ycharge, current);
+    return current;
+}
+
+void SliceImager::process(long slice, const float* Ucharge, const float* Vcharge, const float* Ycharge,
+			  SliceCells& result)
+{
+    fire(Ucharge, coincidence.nwires(kUwire), fired[kUwire].data());
+    fire(Vcharge, coincidence.nwires(kVwire), fired[kVwire].data());
+    fire(Ycharge, coincidence.nwires(kYwire), fired[kYwire].data());
+
+    result.clear();
+    result.slice = slice;
+    coincidence.find(fired[kUwire].data(), fired[kVwire].data(), fired[kYwire].data(), result.cells);
+
+    // Fired cells are formed by wires which exist
+    result.wireCharge.resize(3*result.cells.size());
+    float* wireCharge = result.wireCharge.data();
+    for (size_t ind = 0; ind < result.cells.size(); ++ind) {
+	const int ident = result.cells[ind];
+	wireCharge[3*ind] = Ucharge[store.uindex(ident)];
+	wireCharge[3*ind+1] = Vcharge[store.vindex(ident)];
+	wireCharge[3*ind+2] = Ycharge[store.yindex(ident)];
+    }
+    ++numSlices;
+}
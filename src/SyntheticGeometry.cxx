@@ -0,0 +1,66 @@
+#include "WCPTiling/SyntheticGeometry.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace WCP;
+
+int WCP::addSyntheticPlane(GeomDataSource& gds, WirePlaneType_t plane, double angle, double pitch,
+			   double height, double width, int ident)
+{
+    // Wire i is the line Z*cos(angle) - Y*sin(angle) = c0 + i*pitch.
+    const double cosA = cos(angle), sinA = sin(angle);
+    const double firstZ = 0.5*pitch;
+    double c0 = firstZ*cosA;
+    if (plane == kUwire) {
+	c0 -= height*sinA;
+    }
+    const double corners[4] = {0.0, width*cosA, -height*sinA, width*cosA-height*sinA};
+    double cmax = corners[0];
+    for (int ind = 1; ind < 4; ++ind) {
+	cmax = std::max(cmax, corners[ind]);
+    }
+
+    for (int index = 0; c0 + index*pitch < cmax; ++index) {
+	const double c = c0 + index*pitch;
+
+	// Clip the line to the active rectangle.
+	std::vector<Point> ends;
+	if (std::abs(sinA) < 1e-12) {
+	    ends.push_back(Point(0, 0, c));
+	    ends.push_back(Point(0, height, c));
+	}
+	else {
+	    const double edgeZ[2] = {0.0, width};
+	    for (int ind = 0; ind < 2; ++ind) {
+		const double y = (edgeZ[ind]*cosA - c)/sinA;
+		if (y >= 0 && y <= height) {
+		    ends.push_back(Point(0, y, edgeZ[ind]));
+		}
+	    }
+	    const double edgeY[2] = {0.0, height};
+	    for (int ind = 0; ind < 2 && ends.size() < 2; ++ind) {
+		const double z = (c + edgeY[ind]*sinA)/cosA;
+		if (z > 0 && z < width) {
+		    ends.push_back(Point(0, edgeY[ind], z));
+		}
+	    }
+	}
+	if (ends.size() < 2) {
+	    continue;
+	}
+	gds.add_wire(GeomWire(ident, plane, index, ident, ends[0], ends[1]));
+	++ident;
+    }
+    return ident;
+}
+
+void WCP::makeSyntheticGeometry(GeomDataSource& gds, int numYwires, double angle, double pitch, double height)
+{
+    const double width = numYwires*pitch;
+    int ident = 0;
+    ident = addSyntheticPlane(gds, kUwire, angle, pitch, height, width, ident);
+    ident = addSyntheticPlane(gds, kVwire, -angle, pitch, height, width, ident);
+    ident = addSyntheticPlane(gds, kYwire, 0.0, pitch, height, width, ident);
+}
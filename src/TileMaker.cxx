@@ -1,18 +1,143 @@
 #include "WCPTiling/TileMaker.h"
+#include "WCPTiling/ParallelFor.h"
 
 #include <cmath>
 #include <iostream>
 #include <algorithm> 
+#include <chrono>
 using namespace WCP;
 
 const double epsilon = 0.0000000001;
 
-TileMaker::TileMaker(const GeomDataSource& geom)
-    : TilingBase(), geo(geom)
+// How far the U and V crossings of chains copied from an earlier
+// period may drift from their true positions across the detector.
+const double periodTolerance = 1e-6*units::mm;
+
+// Cells whose vertices relative to their center agree to this share
+// a shape when compacting the cell store.
+const double shapeTolerance = 1e-7*units::mm;
+
+// Points this close to the edge of a wire strip or a cell are taken to
+// be on it when locating the cell containing them.
+const double locateTolerance = 1e-6*units::mm;
+
+// Stretches of a segment shorter than this, where it passes through
+// the corner of a cell, are given to no cell.
+const double traverseTolerance = 1e-6*units::mm;
+
+// Points are located in blocks so the wire triple hash can look up a
+// whole block at once.
+const size_t locateBlock = 64;
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start)
 {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool compareWireIndex(const GeomWire* wire1, const GeomWire* wire2)
+{
+    return wire1->index() < wire2->index();
+}
+
+// A cell is bounded by up to six lines, the two edges of each wire
+// strip.  Walking counter-clockwise around the cell the edges come in
+// order of the angle of their outward normals, and each vertex ends
+// exactly one edge.  Find the position of the edge each candidate
+// vertex ends, which depends only on the wire slopes.
+static void candidateSlots(double Uslope, double Vslope, int* slots)
+{
+    enum { Y1, Y2, U1, U2, V1, V2, numEdges };
+    const double normalZ[numEdges] = {-1.0, 1.0, Uslope, -Uslope, Vslope, -Vslope};
+    const double normalY[numEdges] = {0.0, 0.0, -1.0, 1.0, -1.0, 1.0};
+    const double pi = std::acos(-1.0);
+    const double twopi = 2.0*pi;
+    double angle[numEdges];
+    for (int edge = 0; edge < numEdges; ++edge) {
+	angle[edge] = atan2(normalY[edge], normalZ[edge]);
+	if (angle[edge] < 0) {
+	    angle[edge] += twopi;
+	}
+    }
+    int position[numEdges];
+    for (int edge = 0; edge < numEdges; ++edge) {
+	position[edge] = 0;
+	for (int other = 0; other < numEdges; ++other) {
+	    if (angle[other] < angle[edge] || (angle[other] == angle[edge] && other < edge)) {
+		++position[edge];
+	    }
+	}
+    }
+
+    // The edges each candidate lies on, in CrossingBatch order
+    const int candidateEdges[CrossingBatch::kNumCandidates][2] = {
+	{Y1,U1}, {Y1,U2}, {Y1,V1}, {Y1,V2},
+	{Y2,U1}, {Y2,U2}, {Y2,V1}, {Y2,V2},
+	{U1,V1}, {U1,V2}, {U2,V1}, {U2,V2},
+    };
+    for (int k = 0; k < CrossingBatch::kNumCandidates; ++k) {
+	const int edge1 = candidateEdges[k][0], edge2 = candidateEdges[k][1];
+	double gap = angle[edge2] - angle[edge1];
+	if (gap < 0) {
+	    gap += twopi;
+	}
+	slots[k] = position[gap < pi ? edge1 : edge2];
+    }
+}
+
+TileMakerOptions::TileMakerOptions()
+    : nthreads(1)
+    , analyticCrossings(true)
+    , periodicity(true)
+    , compactCells(false)
+    , verbose(false)
+    , profile(false)
+{
+}
+
+TileMakerStats::TileMakerStats()
+    : setupTime(0), chainTime(0), vertexTime(0), trimTime(0)
+    , storeTime(0), wireMapTime(0), compactTime(0), cacheTime(0), totalTime(0)
+    , formsCellCalls(0), formsCellAccepts(0), cellsDiscarded(0)
+    , cellsTrimmed(0), cellsSorted(0), allocations(0)
+    , period(0), chainsReplicated(0)
+{
+}
+
+TileMakerStats& TileMakerStats::operator+=(const TileMakerStats& other)
+{
+    setupTime += other.setupTime;
+    chainTime += other.chainTime;
+    vertexTime += other.vertexTime;
+    trimTime += other.trimTime;
+    storeTime += other.storeTime;
+    wireMapTime += other.wireMapTime;
+    compactTime += other.compactTime;
+    cacheTime += other.cacheTime;
+    totalTime += other.totalTime;
+    formsCellCalls += other.formsCellCalls;
+    formsCellAccepts += other.formsCellAccepts;
+    cellsDiscarded += other.cellsDiscarded;
+    cellsTrimmed += other.cellsTrimmed;
+    cellsSorted += other.cellsSorted;
+    allocations += other.allocations;
+    period += other.period;
+    chainsReplicated += other.chainsReplicated;
+    return *this;
+}
+
+TileMaker::TileMaker(const GeomDataSource& geom, const TileMakerOptions& options)
+    : TilingBase(), geo(geom), opts(options)
+{
+    const Clock::time_point start = Clock::now();
+
     Uwires = geo.wires_in_plane(WCP::kUwire);
     Vwires = geo.wires_in_plane(WCP::kVwire);
     Ywires = geo.wires_in_plane(WCP::kYwire);
+    std::sort(Uwires.begin(), Uwires.end(), compareWireIndex);
+    std::sort(Vwires.begin(), Vwires.end(), compareWireIndex);
+    std::sort(Ywires.begin(), Ywires.end(), compareWireIndex);
 
     std::vector<double> ext = geo.extent();
     maxHeight = ext[1];
@@ -32,20 +157,83 @@ TileMaker::TileMaker(const GeomDataSource& geom)
     leftEdgeOffsetZval = rightEdgeOffsetZval = 0.0*units::cm;
     firstYwireUoffsetYval = firstYwireVoffsetYval = 0.0 * units::cm;
 
-    std::cerr << "maxHeight=" << maxHeight/units::m << " meter " 
-	      << "angleUrad=" << angleUrad << " radians, " << angleUrad * units::radian/units::degree << " degree "
-	      << "angleVrad=" << angleVrad << " radians, " << angleVrad * units::radian/units::degree << " degree "
-	      << "wirePitchY=" << wirePitchY << " "
-	      <<std::endl;
-
-    angleUrad = geo.pitch(WCP::kUwire)/units::radian;
-    angleVrad = geo.pitch(WCP::kVwire)/units::radian;
+    if (opts.verbose) {
+	std::cerr << "maxHeight=" << maxHeight/units::m << " meter " 
+		  << "angleUrad=" << angleUrad << " radians, " << angleUrad * units::radian/units::degree << " degree "
+		  << "angleVrad=" << angleVrad << " radians, " << angleVrad * units::radian/units::degree << " degree "
+		  << "wirePitchY=" << wirePitchY << " "
+		  <<std::endl;
+    }
 
     UspacingOnWire = std::abs(wirePitchU/sin(angleUrad));
     VspacingOnWire = std::abs(wirePitchV/sin(angleVrad));
 
-    std::cerr << "Tiling..." << std::endl;
+    // formsCell accepts a U/V pair when their separation along Y,
+    // less half of each spacing, stays below this reach.
+    const double tanU = std::abs(tan(angleUrad));
+    const double tanV = std::abs(tan(angleVrad));
+    const double reach = std::max(epsilon, (wirePitchY/2.0+epsilon)*(tanU+tanV)/(tanU*tanV));
+    crossingHalfWidth = (UspacingOnWire+VspacingOnWire)/2.0 + reach;
+
+    candidateSlots(1.0/tan(angleUrad), 1.0/tan(angleVrad), candidateSlot);
+
+    // The active area cells are clipped to, in the order of the
+    // edge types of clipCellVertices: left, right, bottom and top.
+    activeArea[0] = firstYwireZval-0.5*wirePitchY+leftEdgeOffsetZval;
+    activeArea[1] = firstYwireZval+(Ywires.size()-0.5)*wirePitchY-rightEdgeOffsetZval;
+    activeArea[2] = 0.0;
+    activeArea[3] = maxHeight;
+
+    // getUwireID, getVwireID and getYwireID before rounding
+    const double wireCoordinates[3][4] = {
+	{1.0/(tan(angleUrad)*UspacingOnWire), -1.0/UspacingOnWire,
+	 (maxHeight - firstYwireZval/tan(angleUrad) - firstYwireUoffsetYval)/UspacingOnWire,
+	 locateTolerance/wirePitchU},
+	{-1.0/(tan(angleVrad)*VspacingOnWire), 1.0/VspacingOnWire,
+	 (firstYwireZval/tan(angleVrad) - firstYwireVoffsetYval)/VspacingOnWire,
+	 locateTolerance/wirePitchV},
+	{1.0/wirePitchY, 0.0, -firstYwireZval/wirePitchY, locateTolerance/wirePitchY}
+    };
+    std::copy(&wireCoordinates[0][0], &wireCoordinates[0][0]+12, &wireCoordinate[0][0]);
+
+    uint64_t fingerprint = 0;
+    std::string cachePath;
+    if (!opts.cacheDirectory.empty()) {
+	// Replicated chains are only equal to constructed ones up to
+	// rounding and compacted cells share rounded shapes, so both
+	// are cached apart from exact tilings.
+	const uint32_t cacheOptions = (opts.periodicity ? 1 : 0) | (opts.compactCells ? 2 : 0);
+	fingerprint = TilingCache::fingerprint(geo, cacheOptions);
+	cachePath = TilingCache::filename(opts.cacheDirectory, fingerprint);
+	if (loadCache(cachePath, fingerprint)) {
+	    if (opts.verbose) {
+		std::cerr << "Tiling mapped from " << cachePath << std::endl;
+	    }
+	    buildStats.setupTime = seconds_since(start);
+	    if (opts.compactCells) {
+		const Clock::time_point compactStart = Clock::now();
+		store.compact(shapeTolerance);
+		buildStats.compactTime = seconds_since(compactStart);
+	    }
+	    buildStats.totalTime = seconds_since(start);
+	    return;
+	}
+    }
+    buildStats.setupTime = seconds_since(start);
+
+    if (opts.verbose) {
+	std::cerr << "Tiling..." << std::endl;
+    }
     this->constructCells();
+
+    if (!cachePath.empty()) {
+	const Clock::time_point saveStart = Clock::now();
+	if (!saveCache(cachePath, fingerprint) && opts.verbose) {
+	    std::cerr << "Failed to save tiling cache " << cachePath << std::endl;
+	}
+	buildStats.cacheTime = seconds_since(saveStart);
+    }
+    buildStats.totalTime = seconds_since(start);
 }
 
 TileMaker::~TileMaker()
@@ -53,27 +241,111 @@ TileMaker::~TileMaker()
 }
 
 
+const GeomWireSelection& TileMaker::planeWires(WirePlaneType_t plane) const
+{
+    switch(plane) {
+    case kUwire:
+	return Uwires;
+    case kVwire:
+	return Vwires;
+    default:
+	return Ywires;
+    }
+}
+
+const std::vector<GeomCell>& TileMaker::geomCells() const
+{
+    std::call_once(cellviewsOnce, [this]() {
+	const int numCells = store.size();
+	cellviews.reserve(numCells);
+	for (int ident = 0; ident < numCells; ++ident) {
+	    cellviews.push_back(store.geomcell(ident));
+	}
+    });
+    return cellviews;
+}
+
+const CellGraph& TileMaker::cellGraph() const
+{
+    std::call_once(graphOnce, [this]() {
+	StripGeometry strips;
+	std::copy(&wireCoordinate[0][0], &wireCoordinate[0][0]+12, &strips.wire[0][0]);
+	std::copy(activeArea, activeArea+4, strips.area);
+	strips.tolerance = locateTolerance;
+	graph.build(store, index, strips, opts.nthreads);
+    });
+    return graph;
+}
+
+const GeomCell* TileMaker::geomCell(int ident) const
+{
+    if (ident < 0 || ident >= store.size()) {
+	return 0;
+    }
+    return &geomCells()[ident];
+}
+
 GeomWireSelection TileMaker::wires(const GeomCell& cell) const
 {
-    return GeomWireSelection();
+    GeomWireSelection ret;
+    const int ident = cell.ident();
+    if (ident < 0 || ident >= index.ncells()) {
+	return ret;
+    }
+
+    const int* cw = index.cellWires(ident);
+    for (int ind = 0; ind < 3; ++ind) {
+	if (cw[ind] < 0) {
+	    continue;
+	}
+	ret.push_back(planeWires(index.plane(cw[ind]))[index.index(cw[ind])]);
+    }
+    return ret;
 }
 
 GeomCellSelection TileMaker::cells(const GeomWire& wire) const
 {
-    return GeomCellSelection();
+    GeomCellSelection ret;
+    const int num = index.wire(wire.plane(), wire.index());
+    if (num < 0) {
+	return ret;
+    }
+
+    const std::vector<GeomCell>& views = geomCells();
+    const int *it = index.cellsBegin(num), *done = index.cellsEnd(num);
+    ret.reserve(done-it);
+    for (; it != done; ++it) {
+	ret.push_back(&views[*it]);
+    }
+    return ret;
 }
 
-GeomCell* TileMaker::cell(const GeomWireSelection& wires) const
+const GeomCell* TileMaker::cell(const GeomWireSelection& wires) const
 {
+    int windex[3] = {0, 0, 0};
+    bool seen[3] = {false, false, false};
+    for (size_t ind = 0; ind < wires.size(); ++ind) {
+	const GeomWire* wire = wires[ind];
+	if (!wire || wire->plane() < kUwire || wire->plane() > kYwire) {
+	    return 0;
+	}
+	windex[wire->plane()] = wire->index();
+	seen[wire->plane()] = true;
+    }
+    if (!seen[0] || !seen[1] || !seen[2]) {
+	return 0;
+    }
+    return geomCell(triples.find(windex[0], windex[1], windex[2]));
 }
 
 
-bool TileMaker::formsCell(double UwireYval, double VwireYval)
+bool TileMaker::formsCell(double UwireYval, double VwireYval) const
 {
     bool isCell = false;
 
-    const double tanU = tan(angleUrad);
-    const double tanV = tan(angleVrad);
+    // V angles are signed, the crossing geometry only needs magnitudes
+    const double tanU = std::abs(tan(angleUrad));
+    const double tanV = std::abs(tan(angleVrad));
 
     double deltaY = 0;
     if (UwireYval > VwireYval) {
@@ -105,48 +377,23 @@ bool TileMaker::formsCell(double UwireYval, double VwireYval)
 }
 
 
-static std::pair<double,double> getIntersectionUV(double ZvalOffset, double slope1, double intercept1, double slope2, double intercept2)
-{
-    double Yval = (slope2*intercept1-slope1*intercept2)/(slope2-slope1);
-    double Zval = ZvalOffset + (Yval-intercept1)/slope1;
-    
-    std::pair<double,double> intersectionPoint;
-    intersectionPoint.first = Zval;
-    intersectionPoint.second = Yval;
-    
-    return intersectionPoint;
-}
-static std::pair<double, double> getIntersectionY(double ZvalOffset, double YwireZval, double slope, double intercept)
-{
-    double Yval = slope*(YwireZval-ZvalOffset) + intercept;
-    double Zval = YwireZval;
-
-    std::pair<double,double> intersectionPoint;
-    intersectionPoint.first = Zval;
-    intersectionPoint.second = Yval;
-
-    return intersectionPoint;
-}
-
+typedef std::pair<double,CellPolygon::Vertex> OrientedVertex;
 
-
-static bool compareOrientedVertices(std::pair<double,std::pair<double,double> > orientedVertex1,
-				    std::pair<double,std::pair<double,double> > orientedVertex2)
+static bool compareOrientedVertices(const OrientedVertex& orientedVertex1,
+				    const OrientedVertex& orientedVertex2)
 {
     return (orientedVertex1.first > orientedVertex2.first);
 }
 
 
-static std::pair<double,double> calcCellCenter(std::vector<std::pair<double,double> > vertices)
+static std::pair<double,double> calcCellCenter(const CellPolygon::Vertex* vertices, int numVertices)
 {
     double Zval = 0.0;
     double Yval = 0.0;
 
-    const int numVertices = vertices.size();
-
     for (int ind = 0; ind < numVertices; ++ind) {
-       Zval += vertices.at(ind).first;
-       Yval += vertices.at(ind).second;
+       Zval += vertices[ind].first;
+       Yval += vertices[ind].second;
     }  
 
     Zval /= ((double) numVertices);
@@ -161,31 +408,90 @@ static std::pair<double,double> calcCellCenter(std::vector<std::pair<double,doub
 
 
 
-static std::vector<std::pair<double,double> > sortVertices(std::vector<std::pair<double,double> > vertices)
+static double calcCellArea(const CellPolygon::Vertex* vertices, int numVertices)
 {
-    std::vector<std::pair<double,double> > verticesSorted;
+    double cellArea = 0.0;
 
-    if (vertices.size() < 2) {
-	return vertices;
+    int otherind = numVertices-1;
+    for (int ind = 0; ind < numVertices; ++ind) {
+	cellArea += (vertices[otherind].first+vertices[ind].first)*(vertices[otherind].second-vertices[ind].second);
+	otherind = ind;
     }
+    cellArea /= 2.0;
 
-    std::pair<double,double> vertex, center = calcCellCenter(vertices);
-    std::pair<double,std::pair<double,double> > orientedVertex;
-    std::vector<std::pair<double,std::pair<double,double> > > orientedVertices;
-    for (int ind = 0; ind < vertices.size(); ++ind) {
-	vertex = vertices.at(ind);
-	orientedVertex.first = atan2(vertex.second-center.second,vertex.first-center.first);
-	orientedVertex.second = vertex;
-	orientedVertices.push_back(orientedVertex);
+    return cellArea;
+}
+
+
+
+// Order the vertices in place by decreasing angle about their center.
+// A vertex within epsilon of the -Z ray from the center is taken to
+// be on it, at the largest angle, so that rounding does not decide
+// which vertex comes first.
+static void sortVertices(CellPolygon& vertices)
+{
+    const int numVertices = vertices.size();
+    if (numVertices < 2) {
+	return;
+    }
+
+    const std::pair<double,double> center = calcCellCenter(vertices.data(), numVertices);
+    OrientedVertex orientedVertices[CellPolygon::capacity];
+    for (int ind = 0; ind < numVertices; ++ind) {
+	const CellPolygon::Vertex& vertex = vertices[ind];
+	const double dY = vertex.second-center.second, dZ = vertex.first-center.first;
+	orientedVertices[ind].first = (dZ < 0 && std::abs(dY) <= epsilon) ? atan2(0.0, dZ) : atan2(dY, dZ);
+	orientedVertices[ind].second = vertex;
     }
 
-    sort(orientedVertices.begin(),orientedVertices.end(),compareOrientedVertices);
+    std::sort(orientedVertices,orientedVertices+numVertices,compareOrientedVertices);
 
-    for (int ind = 0; ind < orientedVertices.size(); ++ind) {
-	verticesSorted.push_back(orientedVertices.at(ind).second);
+    for (int ind = 0; ind < numVertices; ++ind) {
+	vertices[ind] = orientedVertices[ind].second;
+    }
+}
+
+// Put vertices given counter-clockwise into the order sortVertices
+// gives, clockwise starting at the largest angle about the center.
+// Returns false, leaving the vertices alone, unless the polygon is
+// strictly convex, in which case the two orders agree.
+static bool orderClockwise(CellPolygon& vertices, const std::pair<double,double>& center)
+{
+    const int numVertices = vertices.size();
+
+    int start = -1;
+    for (int ind = 0; ind < numVertices; ++ind) {
+	const CellPolygon::Vertex& prev = vertices[(ind+numVertices-1)%numVertices];
+	const CellPolygon::Vertex& vertex = vertices[ind];
+	const CellPolygon::Vertex& next = vertices[(ind+1)%numVertices];
+	const double cross = (vertex.first-prev.first)*(next.second-vertex.second)
+	    - (vertex.second-prev.second)*(next.first-vertex.first);
+	if (!(cross > 0)) {
+	    return false;
+	}
+
+	// Counter-clockwise the angle about the center wraps from
+	// pi to -pi between the vertex above the -Z ray and the one
+	// below it.  Above includes on the ray, to within epsilon as
+	// in sortVertices.
+	const double dY = vertex.second-center.second, dZ = vertex.first-center.first;
+	const double nextdY = next.second-center.second, nextdZ = next.first-center.first;
+	const bool above = dY > 0 || (dZ < 0 && dY >= -epsilon);
+	const bool nextAbove = nextdY > 0 || (nextdZ < 0 && nextdY >= -epsilon);
+	if (above && !nextAbove) {
+	    start = ind;
+	}
+    }
+    if (start < 0) {
+	return false;
     }
 
-    return verticesSorted;
+    CellPolygon ordered;
+    for (int ind = 0; ind < numVertices; ++ind) {
+	ordered.push_back(vertices[(start-ind+numVertices)%numVertices]);
+    }
+    vertices = ordered;
+    return true;
 }
 
 static bool 
@@ -205,324 +511,761 @@ vertexOutsideBoundary(std::pair<double,double> vertex, int edgeType, double edge
     }
 }
 
-static std::vector<std::pair<double,double> > 
-trimEdgeCellVertices(std::vector<std::pair<double,double> > vertices, 
-		     int edgeType, double edgeVal)
+// Where the polygon edge from vertex1 to vertex2 crosses an edge of
+// the active area, if it does so by more than epsilon.
+static bool
+crossBoundary(const CellPolygon::Vertex& vertex1, const CellPolygon::Vertex& vertex2,
+	      int edgeType, double edgeVal, CellPolygon::Vertex& vertex)
 {
-    std::vector<std::pair<double,double> > edgeCellVertices;
-
-    if((edgeType < 1) && (edgeType > 4)) {
-	return vertices;
-    }
-  
-    int numVertOutside = 0;
-    for (int ind = 0; ind < vertices.size(); ++ind) {
-	if (vertexOutsideBoundary(vertices.at(ind),edgeType,edgeVal) == true) {
-	    numVertOutside++;
+    const double Zval1 = vertex1.first, Zval2 = vertex2.first;
+    const double Yval1 = vertex1.second, Yval2 = vertex2.second;
+
+    if ((edgeType == 1) || (edgeType == 2)) {
+	if ((Zval1 != Zval2) &&
+	    (((edgeVal > Zval1+epsilon) && (edgeVal < Zval2-epsilon)) ||
+	     ((edgeVal > Zval2+epsilon) && (edgeVal < Zval1-epsilon)))) {
+	    const double slope = (Yval2-Yval1)/(Zval2-Zval1);
+	    const double intercept = Yval1-slope*Zval1;
+	    vertex.first = edgeVal;
+	    vertex.second = slope*edgeVal+intercept;
+	    return true;
 	}
+	return false;
     }
 
-    if (numVertOutside == 0) {
-	return vertices;
+    if (((edgeVal > Yval1+epsilon) && (edgeVal < Yval2-epsilon)) || 
+	((edgeVal > Yval2+epsilon) && (edgeVal < Yval1-epsilon))) {
+	if (Zval1 != Zval2) {
+	    const double slope = (Yval2-Yval1)/(Zval2-Zval1);
+	    const double intercept = Yval1-slope*Zval1;
+	    vertex.first = (edgeVal-intercept)/slope;
+	}
+	else {
+	    vertex.first = Zval1;
+	}
+	vertex.second = edgeVal;
+	return true;
     }
+    return false;
+}
 
+// Clip the ordered vertices in place to the active area rectangle,
+// one edge after the other (Sutherland-Hodgman).  Vertices within
+// epsilon of an edge are kept as they are.  Clipping keeps the
+// vertices in order around the cell.  Returns true if any vertex was
+// outside.
+static bool
+clipCellVertices(CellPolygon& vertices, const double edgeVals[4])
+{
+    CellPolygon buffer[2];
+    const CellPolygon* in = &vertices;
+    int clipped = 0;
+    for (int edgeType = 1; edgeType <= 4; ++edgeType) {
+	const double edgeVal = edgeVals[edgeType-1];
+	const int numVertices = in->size();
+	int numVertOutside = 0;
+	for (int ind = 0; ind < numVertices; ++ind) {
+	    numVertOutside += vertexOutsideBoundary((*in)[ind],edgeType,edgeVal);
+	}
+	if (numVertOutside == 0) {
+	    continue;
+	}
 
-    std::pair<double,double> vertex;
-    for(int ind = 0; ind < vertices.size(); ++ind) {
-	int otherind = (ind+1) % vertices.size();
-    
-	double Zval1 = vertices.at(ind).first;
-	double Zval2 = vertices.at(otherind).first;
-	double Yval1 = vertices.at(ind).second;
-	double Yval2 = vertices.at(otherind).second;
-
-	if(Zval1 != Zval2) {
-	    double slope = (Yval2-Yval1)/(Zval2-Zval1);
-	    double intercept = Yval1-slope*Zval1;
-	    
-	    if ((edgeType == 1) || (edgeType == 2)) {
-		if (((edgeVal > Zval1+epsilon) && (edgeVal < Zval2-epsilon)) ||
-		    ((edgeVal > Zval2+epsilon) && (edgeVal < Zval1-epsilon))) {
-		    vertex.first = edgeVal;
-		    vertex.second = slope*edgeVal+intercept;
-		    edgeCellVertices.push_back(vertex);
-		}
-	    }
-	    else if((edgeType == 3) || (edgeType == 4)) {
-		if(((edgeVal > Yval1+epsilon) && (edgeVal < Yval2-epsilon)) || 
-		   ((edgeVal > Yval2+epsilon) && (edgeVal < Yval1-epsilon))) {
-		    vertex.first = (edgeVal-intercept)/slope;
-		    vertex.second = edgeVal;
-		    edgeCellVertices.push_back(vertex);
-		}
+	CellPolygon& out = buffer[clipped++ % 2];
+	out.clear();
+	CellPolygon::Vertex vertex;
+	for (int ind = 0; ind < numVertices; ++ind) {
+	    const CellPolygon::Vertex& vertex1 = (*in)[ind];
+	    const CellPolygon::Vertex& vertex2 = (*in)[(ind+1) % numVertices];
+	    if (!vertexOutsideBoundary(vertex1,edgeType,edgeVal)) {
+		out.push_back(vertex1);
 	    }
-	}
-	else if((edgeType == 3) || (edgeType == 4)) {
-	    if(((edgeVal > Yval1+epsilon) && (edgeVal < Yval2-epsilon)) || 
-	       ((edgeVal > Yval2+epsilon) && (edgeVal < Yval1-epsilon))) {
-		vertex.first = Zval1;
-		vertex.second = edgeVal;
-		edgeCellVertices.push_back(vertex);
+	    if (crossBoundary(vertex1,vertex2,edgeType,edgeVal,vertex)) {
+		out.push_back(vertex);
 	    }
 	}
-    } // loop over vertices
-    
-    for (int ind = 0; ind < vertices.size(); ++ind) {
-	if(vertexOutsideBoundary(vertices.at(ind),edgeType,edgeVal) == false) {
-	    edgeCellVertices.push_back(vertices.at(ind));
-	}
+	in = &out;
     }
-
-    return sortVertices(edgeCellVertices);
+    if (clipped) {
+	vertices = *in;
+    }
+    return clipped > 0;
 }
 
-std::vector<std::pair<double,double> > TileMaker::getCellVertices(double YwireZval, double UwireYval, double VwireYval)
+// Collect, order and trim the vertices of cell ind of a computed batch.
+void TileMaker::getCellVertices(const CrossingBatch& batch, int ind,
+				CellPolygon& cellVertices, TileMakerStats& chainStats) const
 {
-    std::vector<std::pair<double,double> > cellVertices;
-
-    const double U1slope = 1.0/tan(angleUrad);
-    const double U2slope = U1slope;
-    const double U1intercept = UwireYval - UspacingOnWire/2.0;
-    const double U2intercept = UwireYval + UspacingOnWire/2.0;
-
-    const double V1slope = 1.0/tan(angleVrad);
-    const double V2slope = V1slope;
-    const double V1intercept = VwireYval - VspacingOnWire/2.0;
-    const double V2intercept = VwireYval + VspacingOnWire/2.0;
-
-    const double Y1Zval = YwireZval - wirePitchY/2.0;
-    const double Y2Zval = YwireZval + wirePitchY/2.0;
-
-    std::pair<double,double> U1V1intersectionPoint = getIntersectionUV(YwireZval,U1slope,U1intercept,V1slope,V1intercept);
-    std::pair<double,double> U1V2intersectionPoint = getIntersectionUV(YwireZval,U1slope,U1intercept,V2slope,V2intercept);
-    std::pair<double,double> U2V1intersectionPoint = getIntersectionUV(YwireZval,U2slope,U2intercept,V1slope,V1intercept);
-    std::pair<double,double> U2V2intersectionPoint = getIntersectionUV(YwireZval,U2slope,U2intercept,V2slope,V2intercept);
-
-    double UVminZval = U1V1intersectionPoint.first;
-    double UVmaxZval = U1V1intersectionPoint.first;
-    double UVminYval = U1V1intersectionPoint.second;
-    double UVmaxYval = U1V1intersectionPoint.second;
-
-    if (U1V2intersectionPoint.first < UVminZval+epsilon) {
-	UVminZval = U1V2intersectionPoint.first;
-    }
-    if (U1V2intersectionPoint.first > UVmaxZval-epsilon) {
-	UVmaxZval = U1V2intersectionPoint.first;
-    }
-    if (U1V2intersectionPoint.second < UVminYval+epsilon) {
-	UVminYval = U1V2intersectionPoint.second;
-    }
-    if (U1V2intersectionPoint.second > UVmaxYval-epsilon) {
-	UVmaxYval = U1V2intersectionPoint.second;
+    Clock::time_point start;
+    if (opts.profile) {
+	start = Clock::now();
     }
 
-    if (U2V1intersectionPoint.first < UVminZval+epsilon) {
-	UVminZval = U2V1intersectionPoint.first;
-    }
-    if (U2V1intersectionPoint.first > UVmaxZval-epsilon) {
-	UVmaxZval = U2V1intersectionPoint.first;
+    // Place the candidates at their slots around the cell.  A slot
+    // taken twice means a degenerate cell, which is sorted instead.
+    const unsigned int mask = batch.mask[ind];
+    CellPolygon candidates;
+    int slotCandidate[6] = {-1, -1, -1, -1, -1, -1};
+    bool ordered = true;
+    for (int k = 0; k < CrossingBatch::kNumCandidates; ++k) {
+	if (mask & (1u << k)) {
+	    int& taken = slotCandidate[candidateSlot[k]];
+	    ordered = ordered && taken < 0;
+	    taken = candidates.size();
+	    candidates.push_back(std::make_pair(batch.Z[k][ind], batch.Y[k][ind]));
+	}
     }
-    if (U2V1intersectionPoint.second < UVminYval+epsilon) {
-	UVminYval = U2V1intersectionPoint.second;
+
+    cellVertices.clear();
+    if (ordered && candidates.size() >= 3) {
+	for (int slot = 0; slot < 6; ++slot) {
+	    if (slotCandidate[slot] >= 0) {
+		cellVertices.push_back(candidates[slotCandidate[slot]]);
+	    }
+	}
+	// The center as sortVertices would compute it
+	ordered = orderClockwise(cellVertices, calcCellCenter(candidates.data(), candidates.size()));
     }
-    if (U2V1intersectionPoint.second > UVmaxYval-epsilon) {
-	UVmaxYval = U2V1intersectionPoint.second;
+    if (!ordered || candidates.size() < 3) {
+	cellVertices = candidates;
+	sortVertices(cellVertices);
+	chainStats.cellsSorted += !ordered;
     }
 
-    if (U2V2intersectionPoint.first < UVminZval+epsilon) {
-	UVminZval = U2V2intersectionPoint.first;
-    }
-    if (U2V2intersectionPoint.first > UVmaxZval-epsilon) {
-	UVmaxZval = U2V2intersectionPoint.first;
+    Clock::time_point trimStart;
+    if (opts.profile) {
+	trimStart = Clock::now();
     }
-    if (U2V2intersectionPoint.second < UVminYval+epsilon) {
-	UVminYval = U2V2intersectionPoint.second;
+
+    // Only cells whose U/V corners reach an edge of the active area
+    // can need clipping.
+    if (batch.UVminZ[ind] < activeArea[0]+epsilon || batch.UVmaxZ[ind] > activeArea[1]-epsilon ||
+	batch.UVminY[ind] < activeArea[2]+epsilon || batch.UVmaxY[ind] > activeArea[3]-epsilon) {
+	if (clipCellVertices(cellVertices, activeArea)) {
+	    ++chainStats.cellsTrimmed;
+	    // Clipping keeps the clockwise order, restore the start
+	    if (cellVertices.size() >= 3) {
+		CellPolygon reversed;
+		for (int iv = cellVertices.size()-1; iv >= 0; --iv) {
+		    reversed.push_back(cellVertices[iv]);
+		}
+		if (orderClockwise(reversed, calcCellCenter(cellVertices.data(), cellVertices.size()))) {
+		    cellVertices = reversed;
+		}
+		else {
+		    sortVertices(cellVertices);
+		}
+	    }
+	}
     }
-    if (U2V2intersectionPoint.second > UVmaxYval-epsilon) {
-	UVmaxYval = U2V2intersectionPoint.second;
+
+    if (opts.profile) {
+	const Clock::time_point done = Clock::now();
+	chainStats.vertexTime += std::chrono::duration<double>(trimStart - start).count();
+	chainStats.trimTime += std::chrono::duration<double>(done - trimStart).count();
     }
+}
 
-    std::pair<double,double> Y1U1intersectionPoint = getIntersectionY(YwireZval,Y1Zval,U1slope,U1intercept);
-    std::pair<double,double> Y1U2intersectionPoint = getIntersectionY(YwireZval,Y1Zval,U2slope,U2intercept);
-    std::pair<double,double> Y1V1intersectionPoint = getIntersectionY(YwireZval,Y1Zval,V1slope,V1intercept);
-    std::pair<double,double> Y1V2intersectionPoint = getIntersectionY(YwireZval,Y1Zval,V2slope,V2intercept);
-    std::pair<double,double> Y2U1intersectionPoint = getIntersectionY(YwireZval,Y2Zval,U1slope,U1intercept);
-    std::pair<double,double> Y2U2intersectionPoint = getIntersectionY(YwireZval,Y2Zval,U2slope,U2intercept);
-    std::pair<double,double> Y2V1intersectionPoint = getIntersectionY(YwireZval,Y2Zval,V1slope,V1intercept);
-    std::pair<double,double> Y2V2intersectionPoint = getIntersectionY(YwireZval,Y2Zval,V2slope,V2intercept);
 
-    if((Y1U1intersectionPoint.second < UVmaxYval+epsilon) && (Y1U1intersectionPoint.second > UVminYval+epsilon) && (Y1U1intersectionPoint.first < UVmaxZval-epsilon) && (Y1U1intersectionPoint.first > UVminZval+epsilon)) {
-	cellVertices.push_back(Y1U1intersectionPoint);
-    }
-    if((Y1U2intersectionPoint.second < UVmaxYval-epsilon) && (Y1U2intersectionPoint.second > UVminYval+epsilon) && (Y1U2intersectionPoint.first < UVmaxZval-epsilon) && (Y1U2intersectionPoint.first > UVminZval+epsilon)) {
-	cellVertices.push_back(Y1U2intersectionPoint);
-    }
-    if((Y1V1intersectionPoint.second < UVmaxYval-epsilon) && (Y1V1intersectionPoint.second > UVminYval+epsilon) && (Y1V1intersectionPoint.first < UVmaxZval-epsilon) && (Y1V1intersectionPoint.first > UVminZval+epsilon)) {
-	cellVertices.push_back(Y1V1intersectionPoint);
-    }
-    if((Y1V2intersectionPoint.second < UVmaxYval-epsilon) && (Y1V2intersectionPoint.second > UVminYval+epsilon) && (Y1V2intersectionPoint.first < UVmaxZval-epsilon) && (Y1V2intersectionPoint.first > UVminZval+epsilon)) {
-	cellVertices.push_back(Y1V2intersectionPoint);
-    }
 
-    if((Y2U1intersectionPoint.second < UVmaxYval-epsilon) && (Y2U1intersectionPoint.second > UVminYval+epsilon) && (Y2U1intersectionPoint.first < UVmaxZval-epsilon) && (Y2U1intersectionPoint.first > UVminZval+epsilon)) {
-	cellVertices.push_back(Y2U1intersectionPoint);
-    }
-    if((Y2U2intersectionPoint.second < UVmaxYval-epsilon) && (Y2U2intersectionPoint.second > UVminYval+epsilon) && (Y2U2intersectionPoint.first < UVmaxZval-epsilon) && (Y2U2intersectionPoint.first > UVminZval+epsilon)) {
-	cellVertices.push_back(Y2U2intersectionPoint);
-    }
-    if((Y2V1intersectionPoint.second < UVmaxYval-epsilon) && (Y2V1intersectionPoint.second > UVminYval+epsilon) && (Y2V1intersectionPoint.first < UVmaxZval-epsilon) && (Y2V1intersectionPoint.first > UVminZval+epsilon)) {
-	cellVertices.push_back(Y2V1intersectionPoint);
+int TileMaker::getUwireID(double Yval, double Zval) const
+{
+    return round((Zval/tan(angleUrad) + maxHeight - (firstYwireZval/tan(angleUrad)) - firstYwireUoffsetYval - Yval)/UspacingOnWire);
+}
+int TileMaker::getVwireID(double Yval, double Zval) const
+{
+    // V wires fall with Z, so a (signed) V angle enters with a minus sign
+    return round((firstYwireZval/tan(angleVrad) - Zval/tan(angleVrad) - firstYwireVoffsetYval + Yval)/VspacingOnWire);
+}
+
+int TileMaker::getYwireID(double Zval) const
+{
+    return round((Zval-firstYwireZval)/wirePitchY);
+}
+
+// Find the nearest wire of each plane to the point.  Where the point
+// is within the locate tolerance of the edge of that wire's strip,
+// wother holds the wire on the far side of the edge, else the same
+// wire.  Returns true if any plane has such a second wire.
+bool TileMaker::nearestWires(double Yval, double Zval, int* windex, int* wother) const
+{
+    bool tied = false;
+    for (int plane = 0; plane < 3; ++plane) {
+	const double* coord = wireCoordinate[plane];
+	const double frac = coord[0]*Zval + coord[1]*Yval + coord[2];
+	const double nearest = std::floor(frac + 0.5);
+	const double offset = frac - nearest;
+	windex[plane] = wother[plane] = nearest;
+	if (std::abs(offset) > 0.5 - coord[3]) {
+	    wother[plane] += offset > 0 ? 1 : -1;
+	    tied = true;
+	}
     }
-    if((Y2V2intersectionPoint.second < UVmaxYval-epsilon) && (Y2V2intersectionPoint.second > UVminYval+epsilon) && (Y2V2intersectionPoint.first < UVmaxZval-epsilon) && (Y2V2intersectionPoint.first > UVminZval+epsilon)) {
-	cellVertices.push_back(Y2V2intersectionPoint);
+    return tied;
+}
+
+// True if the point is inside the cell's polygon or within the
+// locate tolerance of its edges.
+bool TileMaker::cellContains(int ident, double Yval, double Zval) const
+{
+    const int num = store.nvertices(ident);
+    bool left = false, right = false;
+    for (int ind = 0; ind < num; ++ind) {
+	const int next = ind+1 < num ? ind+1 : 0;
+	const double Z1 = store.vertexZ(ident,ind), Y1 = store.vertexY(ident,ind);
+	const double dZ = store.vertexZ(ident,next) - Z1, dY = store.vertexY(ident,next) - Y1;
+	const double cross = dZ*(Yval-Y1) - dY*(Zval-Z1);
+	const double reach = locateTolerance*std::sqrt(dZ*dZ + dY*dY);
+	if (cross < -reach) {
+	    left = true;
+	}
+	else if (cross > reach) {
+	    right = true;
+	}
     }
+    return !(left && right);
+}
 
-    if((U1V1intersectionPoint.first >= Y1Zval-epsilon) && (U1V1intersectionPoint.first <= Y2Zval+epsilon)) {
-	cellVertices.push_back(U1V1intersectionPoint);
+// Try the triples mixing the nearest wires with those across a strip
+// edge the point lies on.  The triple of nearest wires is assumed to
+// have been tried already.
+int TileMaker::locateNear(double Yval, double Zval, const int* windex, const int* wother) const
+{
+    int tied = 0;
+    for (int plane = 0; plane < 3; ++plane) {
+	if (wother[plane] != windex[plane]) {
+	    tied |= 1 << plane;
+	}
     }
-    if((U1V2intersectionPoint.first >= Y1Zval-epsilon) && (U1V2intersectionPoint.first <= Y2Zval+epsilon)) {
-	cellVertices.push_back(U1V2intersectionPoint);
+    for (int choice = 1; choice < 8; ++choice) {
+	if (choice & ~tied) {
+	    continue;
+	}
+	int w[3];
+	for (int plane = 0; plane < 3; ++plane) {
+	    w[plane] = (choice >> plane) & 1 ? wother[plane] : windex[plane];
+	}
+	const int ident = triples.find(w[0], w[1], w[2]);
+	if (ident >= 0 && cellContains(ident, Yval, Zval)) {
+	    return ident;
+	}
     }
-    if((U2V1intersectionPoint.first >= Y1Zval-epsilon) && (U2V1intersectionPoint.first <= Y2Zval+epsilon)) {
-	cellVertices.push_back(U2V1intersectionPoint);
+    return -1;
+}
+
+int TileMaker::locate(double Yval, double Zval) const
+{
+    int windex[3], wother[3];
+    const bool tied = nearestWires(Yval, Zval, windex, wother);
+    const int ident = triples.find(windex[0], windex[1], windex[2]);
+    if (ident >= 0 && cellContains(ident, Yval, Zval)) {
+	return ident;
     }
-    if((U2V2intersectionPoint.first >= Y1Zval-epsilon) && (U2V2intersectionPoint.first <= Y2Zval+epsilon)) {
-	cellVertices.push_back(U2V2intersectionPoint);
+    return tied ? locateNear(Yval, Zval, windex, wother) : -1;
+}
+
+void TileMaker::locate(size_t n, const double* Yval, const double* Zval, int* ids) const
+{
+    int windex[3][locateBlock], wother[3];
+    for (size_t base = 0; base < n; base += locateBlock) {
+	const size_t num = std::min(locateBlock, n-base);
+	for (size_t ind = 0; ind < num; ++ind) {
+	    int w[3];
+	    nearestWires(Yval[base+ind], Zval[base+ind], w, wother);
+	    windex[0][ind] = w[0];
+	    windex[1][ind] = w[1];
+	    windex[2][ind] = w[2];
+	}
+	triples.find(num, windex[0], windex[1], windex[2], ids+base);
+
+	for (size_t ind = 0; ind < num; ++ind) {
+	    const double Y = Yval[base+ind], Z = Zval[base+ind];
+	    int& ident = ids[base+ind];
+	    if (ident >= 0 && cellContains(ident, Y, Z)) {
+		continue;
+	    }
+	    int w[3];
+	    ident = nearestWires(Y, Z, w, wother) ? locateNear(Y, Z, w, wother) : -1;
+	}
     }
+}
 
-    std::vector<std::pair<double,double> > cellVerticesSorted = sortVertices(cellVertices);
 
-    const int numYwires = Ywires.size();
+// Walk the segment across the strip edges of the three planes within
+// the active area, calling stretch(wires, length) with the wire index
+// of each plane for every stretch between consecutive edges.  The
+// fractional wire index of a plane changes linearly along the segment
+// so the edges are crossed at evenly spaced fractions of it.
+template <class Stretch>
+void TileMaker::walkSegment(double Y1, double Z1, double Y2, double Z2, Stretch stretch) const
+{
+    const double dZ = Z2 - Z1, dY = Y2 - Y1;
+    const double length = std::sqrt(dZ*dZ + dY*dY);
+    if (length < traverseTolerance) {
+	return;
+    }
 
-    if(UVminZval < (firstYwireZval-0.5*wirePitchY+leftEdgeOffsetZval)+epsilon) {
-	cellVerticesSorted = trimEdgeCellVertices(cellVerticesSorted,1,firstYwireZval-0.5*wirePitchY+leftEdgeOffsetZval);
+    // Clip to the active area
+    double first = 0.0, last = 1.0;
+    const double delta[4] = {-dZ, dZ, -dY, dY};
+    const double reach[4] = {Z1 - activeArea[0], activeArea[1] - Z1, Y1 - activeArea[2], activeArea[3] - Y1};
+    for (int edge = 0; edge < 4; ++edge) {
+	if (delta[edge] == 0.0) {
+	    if (reach[edge] < 0.0) {
+		return;
+	    }
+	    continue;
+	}
+	const double frac = reach[edge]/delta[edge];
+	if (delta[edge] < 0.0) {
+	    first = std::max(first, frac);
+	}
+	else {
+	    last = std::min(last, frac);
+	}
     }
-    else if(UVmaxZval > (firstYwireZval+(numYwires-0.5)*wirePitchY-rightEdgeOffsetZval)-epsilon) {
-	cellVerticesSorted = trimEdgeCellVertices(cellVerticesSorted,2,(firstYwireZval+(numYwires-0.5)*wirePitchY-rightEdgeOffsetZval));
+    if ((last - first)*length < traverseTolerance) {
+	return;
     }
 
-    if(UVminYval < epsilon) {
-	cellVerticesSorted = trimEdgeCellVertices(cellVerticesSorted,3,0.0);
-    }
-    else if(UVmaxYval > maxHeight-epsilon) {
-	cellVerticesSorted = trimEdgeCellVertices(cellVerticesSorted,4,maxHeight);
+    // The fractional wire index of each plane at the start and its
+    // change over the whole segment, and the fraction at which the
+    // next strip edge is crossed.  Edges lie half way between wires.
+    double start[3], change[3], inverse[3], edge[3], next[3];
+    for (int plane = 0; plane < 3; ++plane) {
+	const double* coord = wireCoordinate[plane];
+	start[plane] = coord[0]*Z1 + coord[1]*Y1 + coord[2];
+	change[plane] = coord[0]*dZ + coord[1]*dY;
+	const double at = start[plane] + first*change[plane];
+	if (change[plane] > 0.0) {
+	    edge[plane] = std::floor(at + 0.5) + 0.5;
+	}
+	else if (change[plane] < 0.0) {
+	    edge[plane] = std::ceil(at - 0.5) - 0.5;
+	}
+	else {
+	    // Never advanced, but set so no path reads them unset
+	    edge[plane] = inverse[plane] = 0.0;
+	    next[plane] = last;
+	    continue;
+	}
+	inverse[plane] = 1.0/change[plane];
+	next[plane] = (edge[plane] - start[plane])*inverse[plane];
     }
 
-    return cellVerticesSorted;
+    double frac = first;
+    int wires[3];
+    while (frac < last) {
+	const double upto = std::min(last, std::min(next[0], std::min(next[1], next[2])));
+	if ((upto - frac)*length >= traverseTolerance) {
+	    // The wires are taken at the middle of the stretch, away
+	    // from the edges bounding it.
+	    const double middle = 0.5*(frac + upto);
+	    for (int plane = 0; plane < 3; ++plane) {
+		wires[plane] = std::floor(start[plane] + middle*change[plane] + 0.5);
+	    }
+	    stretch(wires, (upto - frac)*length);
+	}
+	for (int plane = 0; plane < 3; ++plane) {
+	    if (change[plane] != 0.0 && next[plane] <= upto) {
+		edge[plane] += change[plane] > 0.0 ? 1.0 : -1.0;
+		next[plane] = (edge[plane] - start[plane])*inverse[plane];
+	    }
+	}
+	frac = upto;
+    }
 }
 
-
-
-int TileMaker::getUwireID(double Yval, double Zval)
-{
-    return round((Zval/tan(angleUrad) + maxHeight - (firstYwireZval/tan(angleUrad)) - firstYwireUoffsetYval - Yval)/UspacingOnWire);
-}
-int TileMaker::getVwireID(double Yval, double Zval)
+size_t TileMaker::traverse(double Y1, double Z1, double Y2, double Z2,
+			   std::vector<CellCrossing>& crossed) const
 {
-    return round((Zval/tan(angleVrad) - firstYwireZval/tan(angleVrad) - firstYwireVoffsetYval + Yval)/VspacingOnWire);
+    const size_t before = crossed.size();
+    walkSegment(Y1, Z1, Y2, Z2, [&](const int* wires, double length) {
+	const CellCrossing crossing = {triples.find(wires[0], wires[1], wires[2]), length};
+	if (crossing.cell >= 0) {
+	    crossed.push_back(crossing);
+	}
+    });
+    return crossed.size() - before;
 }
 
-int TileMaker::getYwireID(double Zval)
+void TileMaker::traverse(size_t n, const double* Y1, const double* Z1, const double* Y2, const double* Z2,
+			 std::vector<CellCrossing>& crossed, size_t* offsets) const
 {
-    return round((Zval-firstYwireZval)/wirePitchY);
+    // Walk every segment, then look up all the wire triples at once
+    // and drop the stretches outside every cell.
+    std::vector<int> wires[3];
+    crossed.clear();
+    for (size_t ind = 0; ind < n; ++ind) {
+	offsets[ind] = crossed.size();
+	walkSegment(Y1[ind], Z1[ind], Y2[ind], Z2[ind], [&](const int* w, double length) {
+	    for (int plane = 0; plane < 3; ++plane) {
+		wires[plane].push_back(w[plane]);
+	    }
+	    const CellCrossing crossing = {-1, length};
+	    crossed.push_back(crossing);
+	});
+    }
+    offsets[n] = crossed.size();
+
+    std::vector<int> ids(crossed.size());
+    triples.find(ids.size(), wires[0].data(), wires[1].data(), wires[2].data(), ids.data());
+
+    size_t kept = 0;
+    for (size_t ind = 0; ind < n; ++ind) {
+	const size_t begin = offsets[ind];
+	offsets[ind] = kept;
+	for (size_t from = begin; from < offsets[ind+1]; ++from) {
+	    if (ids[from] >= 0) {
+		crossed[kept].cell = ids[from];
+		crossed[kept].length = crossed[from].length;
+		++kept;
+	    }
+	}
+    }
+    offsets[n] = kept;
+    crossed.resize(kept);
 }
 
 
-void TileMaker::constructCell(double YwireZval, double UwireYval, double VwireYval)
+// Compute the vertices of a batch of cells along one Y wire and
+// append those which survive to the chain.  Empties the batch.
+void TileMaker::constructBatch(const CrossingStrip& strip, CrossingBatch& batch, CellChain& chain,
+			       TileMakerStats& chainStats) const
 {
-    std::vector<std::pair<double,double> > vertices = getCellVertices(YwireZval,UwireYval,VwireYval);
-    if(vertices.size() > 2) {
-	return;
+    Clock::time_point start;
+    if (opts.profile) {
+	start = Clock::now();
     }
+    crossings(strip, batch);
+    if (opts.profile) {
+	chainStats.vertexTime += seconds_since(start);
+    }
+
+    const int yindex = getYwireID(strip.Zval);
+    CellPolygon cell;
+    for (int ind = 0; ind < batch.size; ++ind) {
+	getCellVertices(batch,ind,cell,chainStats);
+	if(cell.size() < 3) {
+	    ++chainStats.cellsDiscarded;
+	    continue;
+	}
 
-    int ident = cellset.size();
-    PointVector boundary;
-    for (size_t ind=0; ind<vertices.size(); ++ind) {
-	std::pair<double,double> v = vertices[ind];
-	boundary.push_back(Point(0, v.second, v.first));
+	if (chain.vertexOffset.empty()) {
+	    chain.vertexOffset.push_back(0);
+	}
+	chain.vertices.insert(chain.vertices.end(), cell.begin(), cell.end());
+	chain.vertexOffset.push_back(chain.vertices.size());
+	chain.uindex.push_back(getUwireID(batch.Uval[ind],strip.Zval));
+	chain.vindex.push_back(getVwireID(batch.Vval[ind],strip.Zval));
+	chain.yindex.push_back(yindex);
     }
-    std::pair<GeomCellSet::iterator, bool> it = 
-	cellset.insert(GeomCell(ident, boundary));
-    const GeomCell* saved = &(*(it.first));
-    
-    GeomWireSelection ws;
-    ws.push_back(Uwires[getUwireID(UwireYval,YwireZval)]);
-    ws.push_back(Vwires[getVwireID(VwireYval,YwireZval)]);
-    ws.push_back(Ywires[getYwireID(YwireZval)]);
+    batch.size = 0;
+}
 
-    cellmap[saved] = ws;
+void TileMaker::storeCellChain(const CellChain& chain)
+{
+    for (int icell=0; icell<chain.size(); ++icell) {
+	const CellPolygon::Vertex* vertices = chain.vertices.data() + chain.vertexOffset[icell];
+	const int numVertices = chain.vertexOffset[icell+1] - chain.vertexOffset[icell];
+	store.add(vertices, numVertices,
+		  calcCellCenter(vertices, numVertices), calcCellArea(vertices, numVertices),
+		  chain.uindex[icell], chain.vindex[icell], chain.yindex[icell]);
+    }
 }
 
 
 
-//vector<Cell> 
-void TileMaker::constructCellChain(double wireZval, double YvalOffsetU, double YvalOffsetV)
+// Find the V crossings which may form a cell with the U crossing at
+// UwireYval.  This is the closed form of the formsCell conditions and
+// may be off by one crossing at either end due to rounding.  Returns
+// false if no V crossing can form a cell.
+bool TileMaker::crossingRange(double UwireYval, double YvalOffsetV, int numVcrosses,
+			      int& indVmin, int& indVmax) const
+{
+    double lo = (UwireYval-crossingHalfWidth-YvalOffsetV)/VspacingOnWire;
+    double hi = (UwireYval+crossingHalfWidth-YvalOffsetV)/VspacingOnWire;
+
+    // Both crossings below the bottom edge
+    if (UwireYval+UspacingOnWire/2.0 < -1.0*epsilon) {
+	lo = std::max(lo, (-1.0*epsilon-VspacingOnWire/2.0-YvalOffsetV)/VspacingOnWire);
+    }
+    // Both crossings above the top edge
+    if (UwireYval-UspacingOnWire/2.0 > maxHeight) {
+	hi = std::min(hi, (maxHeight+epsilon+VspacingOnWire/2.0-YvalOffsetV)/VspacingOnWire);
+    }
+
+    indVmin = std::max(0, (int)std::floor(lo));
+    indVmax = std::min(numVcrosses-1, (int)std::ceil(hi));
+    return indVmin <= indVmax;
+}
+
+void TileMaker::constructCellChain(double wireZval, double YvalOffsetU, double YvalOffsetV, CellChain& chain,
+				   TileMakerStats& chainStats) const
 { 
     int numUcrosses = std::ceil(((UdeltaY-UspacingOnWire)/2.0+YvalOffsetU)/UspacingOnWire)+1;
     int numVcrosses = std::ceil((maxHeight-(VdeltaY+VspacingOnWire)/2.0-YvalOffsetV)/VspacingOnWire)+1;
 
+    // U crossings this far above the top edge can not reach any V
+    // crossing which forms a cell.
+    int firstU = 0;
+    if (opts.analyticCrossings) {
+	const double Umax = maxHeight + VspacingOnWire + crossingHalfWidth;
+	if (YvalOffsetU > Umax) {
+	    firstU = std::floor((YvalOffsetU-Umax)/UspacingOnWire);
+	}
+    }
+
+    // Cells forming along the chain are gathered into batches whose
+    // candidate vertices are computed together.
+    CrossingStrip strip;
+    strip.Zval = wireZval;
+    strip.Z1 = wireZval - wirePitchY/2.0;
+    strip.Z2 = wireZval + wirePitchY/2.0;
+    strip.Uslope = 1.0/tan(angleUrad);
+    strip.Vslope = 1.0/tan(angleVrad);
+    strip.UhalfWidth = UspacingOnWire/2.0;
+    strip.VhalfWidth = VspacingOnWire/2.0;
+    strip.epsilon = epsilon;
+    CrossingBatch batch;
+
+    for (int indU = firstU; indU < numUcrosses; indU++) {
+	const double UwireYval = YvalOffsetU-indU*UspacingOnWire;
+
+	int indVmin = 0, indVmax = numVcrosses-1;
+	if (opts.analyticCrossings) {
+	    if (!crossingRange(UwireYval, YvalOffsetV, numVcrosses, indVmin, indVmax)) {
+		continue;
+	    }
+	}
 
-    for (int indU = 0; indU < numUcrosses; indU++) {
 	bool flag1 = false, flag2 = false;
-	
-	for (int indV=0; indV < numVcrosses && !flag2; ++indV) {
+	for (int indV=indVmin; indV <= indVmax && !flag2; ++indV) {
+	    const double VwireYval = YvalOffsetV+indV*VspacingOnWire;
 
-	    if (formsCell(YvalOffsetU-indU*UspacingOnWire,YvalOffsetV+indV*VspacingOnWire)) {
+	    ++chainStats.formsCellCalls;
+	    if (formsCell(UwireYval,VwireYval)) {
+		++chainStats.formsCellAccepts;
 		flag1 = true;
-		constructCell(wireZval,YvalOffsetU-indU*UspacingOnWire,YvalOffsetV+indV*VspacingOnWire);
+		batch.Uval[batch.size] = UwireYval;
+		batch.Vval[batch.size] = VwireYval;
+		if (++batch.size == CrossingBatch::capacity) {
+		    constructBatch(strip,batch,chain,chainStats);
+		}
 	    }
 	    else if (flag1 == true) {
 		flag2 = true;
 	    }
 	}
     }
- 
-    //return cellChain;
+    if (batch.size) {
+	constructBatch(strip,batch,chain,chainStats);
+    }
 }
 
 
-//vector<Cell> 
-void TileMaker::constructCells()
+// Each chain's offsets are computed directly from its Y wire index,
+// rather than accumulated from the previous chain, so that chains
+// may be built independently and in any order.
+void TileMaker::chainOffsets(int ind, double& Zval, double& Uoffset, double& Voffset) const
 {
-    double Zval = firstYwireZval;
-    double Uoffset = maxHeight-firstYwireUoffsetYval;
-    double Voffset = firstYwireVoffsetYval;
+    const double Umin = maxHeight-((UspacingOnWire-UdeltaY)/2.0)-epsilon;
+    const double Vmax = ((VspacingOnWire+VdeltaY)/2.0)+epsilon;
+    const double Vmin = ((VdeltaY-VspacingOnWire)/2.0)-epsilon;
+
+    Zval = firstYwireZval + ind*wirePitchY;
 
-    while(Uoffset < maxHeight-((UspacingOnWire-UdeltaY)/2.0)-epsilon) {
-	std::cerr << Uoffset << " " << maxHeight-((UspacingOnWire-UdeltaY)/2.0)-epsilon << " " << UspacingOnWire << std::endl;
+    Uoffset = maxHeight-firstYwireUoffsetYval;
+    while(Uoffset < Umin) {
 	Uoffset += UspacingOnWire;
     }
-    while(Voffset > ((VspacingOnWire+VdeltaY)/2.0)+epsilon) {
+    Uoffset += ind*UdeltaY;
+    if (Uoffset < Umin) {
+	Uoffset += std::ceil((Umin-Uoffset)/UspacingOnWire)*UspacingOnWire;
+	while(Uoffset < Umin) {
+	    Uoffset += UspacingOnWire;
+	}
+    }
+
+    Voffset = firstYwireVoffsetYval;
+    while(Voffset > Vmax) {
 	Voffset -= VspacingOnWire;
     }
+    Voffset += ind*VdeltaY;
+    if (ind > 0 && Voffset < Vmin) {
+	Voffset += std::ceil((Vmin-Voffset)/VspacingOnWire)*VspacingOnWire;
+	while(Voffset < Vmin) {
+	    Voffset += VspacingOnWire;
+	}
+    }
+}
 
+// The smallest number of Y wires after which the U and V crossings
+// along a chain repeat, up to a whole number of wire spacings, or 0.
+// A period is only accepted if the mismatch it accumulates across the
+// whole detector stays below periodTolerance.
+int TileMaker::chainPeriod() const
+{
     const int numYwires = Ywires.size();
-    for (int ind = 0; ind < numYwires; ++ind) {
-	std::cerr << "Constructing cell chain " << ind << " " << Zval << " " << Uoffset << " " << Voffset << std::endl; 
-	constructCellChain(Zval,Uoffset,Voffset); 
-	Zval += wirePitchY;
-	Uoffset += UdeltaY;
-	Voffset += VdeltaY;
+    const int maxPeriod = std::min(numYwires/4, 1024);
+    for (int period = 1; period <= maxPeriod; ++period) {
+	const double Ushift = period*UdeltaY/UspacingOnWire;
+	const double Vshift = period*VdeltaY/VspacingOnWire;
+	const double drift = (double)numYwires/period;
+	if (std::abs(Ushift-round(Ushift))*UspacingOnWire*drift < periodTolerance &&
+	    std::abs(Vshift-round(Vshift))*VspacingOnWire*drift < periodTolerance) {
+	    return period;
+	}
+    }
+    return 0;
+}
 
-	while(Uoffset < maxHeight-((UspacingOnWire-UdeltaY)/2.0)-epsilon) {
-	    Uoffset += UspacingOnWire;
+// True if cells of the chain may reach the left or right edge of the
+// active area and so need clipping there.
+bool TileMaker::edgeChain(int ind) const
+{
+    const double Zval = firstYwireZval + ind*wirePitchY;
+    return (Zval - wirePitchY/2.0 < activeArea[0]+epsilon) || (Zval + wirePitchY/2.0 > activeArea[1]-epsilon);
+}
+
+// Make chain a copy of the chain shift Y wires before it, moved along
+// Z.  The U and V crossings of the two chains differ by a whole number
+// of wire spacings, which shifts their wire indices.
+void TileMaker::replicateChain(const CellChain& from, int shift, CellChain& chain) const
+{
+    const double dZ = shift*wirePitchY;
+    const int dU = round(shift*UdeltaY/UspacingOnWire);
+    const int dV = round(-shift*VdeltaY/VspacingOnWire);
+
+    chain = from;
+    for (size_t ind = 0; ind < chain.vertices.size(); ++ind) {
+	chain.vertices[ind].first += dZ;
+    }
+    for (int ind = 0; ind < chain.size(); ++ind) {
+	chain.uindex[ind] += dU;
+	chain.vindex[ind] += dV;
+	chain.yindex[ind] += shift;
+    }
+}
+
+void TileMaker::constructCells()
+{
+    const int numYwires = Ywires.size();
+    std::vector<CellChain> chains(numYwires);
+    std::vector<TileMakerStats> chainStats(numYwires);
+
+    // With a period, only the chains at the left and right edges and
+    // the first period of interior chains are built.  Every other
+    // chain copies the one a whole number of periods before it.
+    const int period = opts.periodicity ? chainPeriod() : 0;
+    std::vector<int> source(numYwires, -1);
+    std::vector<int> built, copied;
+    int firstInterior = -1;
+    for (int ind = 0; ind < numYwires; ++ind) {
+	if (period && !edgeChain(ind)) {
+	    if (firstInterior < 0) {
+		firstInterior = ind;
+	    }
+	    if (ind - firstInterior >= period) {
+		source[ind] = firstInterior + (ind-firstInterior) % period;
+		copied.push_back(ind);
+		continue;
+	    }
 	}
-	while(Voffset < ((VdeltaY-VspacingOnWire)/2.0)-epsilon) {
-	    Voffset += VspacingOnWire;
+	built.push_back(ind);
+    }
+    buildStats.period = period;
+    buildStats.chainsReplicated = copied.size();
+
+    Clock::time_point start = Clock::now();
+    parallel_for(built.size(), opts.nthreads, [&](int job) {
+	const int ind = built[job];
+	const long nalloc = thread_allocation_count();
+	double Zval=0, Uoffset=0, Voffset=0;
+	chainOffsets(ind, Zval, Uoffset, Voffset);
+	constructCellChain(Zval, Uoffset, Voffset, chains[ind], chainStats[ind]);
+	chainStats[ind].allocations = thread_allocation_count() - nalloc;
+    });
+    parallel_for(copied.size(), opts.nthreads, [&](int job) {
+	const int ind = copied[job];
+	const long nalloc = thread_allocation_count();
+	replicateChain(chains[source[ind]], ind-source[ind], chains[ind]);
+	chainStats[ind].allocations = thread_allocation_count() - nalloc;
+    });
+    buildStats.chainTime = seconds_since(start);
+
+    // Cell IDs are handed out in chain order, independent of how
+    // the chains were scheduled.
+    start = Clock::now();
+    size_t ncells = 0, nvertices = 0;
+    for (int ind = 0; ind < numYwires; ++ind) {
+	ncells += chains[ind].size();
+	nvertices += chains[ind].vertices.size();
+    }
+    store.reserve(ncells, nvertices);
+    // Source chains are only released once no later chain copies them.
+    for (int ind = 0; ind < numYwires; ++ind) {
+	if (opts.verbose) {
+	    std::cerr << "Storing cell chain " << ind << " with " << chains[ind].size() << " cells" << std::endl; 
 	}
+	storeCellChain(chains[ind]);
+	if (!period || ind >= firstInterior+period || ind < firstInterior) {
+	    chains[ind] = CellChain();
+	}
+	buildStats += chainStats[ind];
     }
+    buildStats.storeTime = seconds_since(start);
 
-    std::cerr << "Filling wire-cell mesh" << std::endl;
-
-    GeomCellMap::iterator it, done = cellmap.end();
-    for (it=cellmap.begin(); it != done; ++it) {
-	const GeomCell* cell = it->first;
-	const GeomWireSelection& wires = it->second;
-	for (size_t ind=0; ind < wires.size(); ++ind) {
-	    const GeomWire* wire = wires[ind];
-	    wiremap[wire].push_back(cell);
+    if (opts.compactCells) {
+	start = Clock::now();
+	const bool compacted = store.compact(shapeTolerance);
+	if (opts.verbose && compacted) {
+	    std::cerr << "Compacted cells into " << store.nshapes() << " shapes" << std::endl;
 	}
+	else if (opts.verbose) {
+	    std::cerr << "Too few repeated cell shapes to compact" << std::endl;
+	}
+	buildStats.compactTime = seconds_since(start);
+    }
+
+    if (opts.verbose) {
+	std::cerr << "Filling wire-cell mesh" << std::endl;
     }
+    start = Clock::now();
+    index.build(store, Uwires.size(), Vwires.size(), Ywires.size());
+    triples.build(store);
+    buildStats.wireMapTime = seconds_since(start);
 }
 
+bool TileMaker::loadCache(const std::string& path, uint64_t fingerprint)
+{
+    if (!cache.open(path, fingerprint)) {
+	return false;
+    }
+    TilingCacheReader in = cache.reader();
+    if (store.load(in) && index.load(in) && triples.load(in)
+	&& index.ncells() == store.size()
+	&& index.nwires(kUwire) == (int)Uwires.size()
+	&& index.nwires(kVwire) == (int)Vwires.size()
+	&& index.nwires(kYwire) == (int)Ywires.size()) {
+	return true;
+    }
+
+    store.clear();
+    index.build(store, 0, 0, 0);
+    triples.build(store);
+    cache.close();
+    return false;
+}
 
+bool TileMaker::saveCache(const std::string& path, uint64_t fingerprint) const
+{
+    TilingCacheWriter out;
+    if (!out.open(path, fingerprint)) {
+	return false;
+    }
+    store.save(out);
+    index.save(out);
+    triples.save(out);
+    return out.commit();
+}
@@ -0,0 +1,251 @@
+#include "WCPTiling/TilingCache.h"
+
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace WCP;
+
+const uint32_t TilingCache::version;
+
+static const char cacheMagic[8] = {'W','C','P','T','I','L','E','\0'};
+static const uint32_t cacheByteOrder = 0x01020304;
+static const size_t cacheAlign = 8;
+
+// FNV-1a, 64 bit
+static void hashBytes(uint64_t& hash, const void* data, size_t nbytes)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t ind = 0; ind < nbytes; ++ind) {
+	hash ^= bytes[ind];
+	hash *= 0x100000001b3ULL;
+    }
+}
+
+template<typename T>
+static void hashValue(uint64_t& hash, T value)
+{
+    hashBytes(hash, &value, sizeof(value));
+}
+
+
+TilingCacheWriter::TilingCacheWriter()
+    : fp(0), ok(false)
+{
+}
+
+TilingCacheWriter::~TilingCacheWriter()
+{
+    if (fp) {
+	std::fclose(fp);
+	::unlink(tmppath.c_str());
+    }
+}
+
+bool TilingCacheWriter::open(const std::string& thepath, uint64_t fingerprint)
+{
+    path = thepath;
+
+    std::vector<char> name(path.begin(), path.end());
+    const char suffix[] = ".XXXXXX";
+    name.insert(name.end(), suffix, suffix+sizeof(suffix));
+    int fd = ::mkstemp(&name[0]);
+    if (fd < 0) {
+	return false;
+    }
+    tmppath = &name[0];
+    fp = ::fdopen(fd, "wb");
+    if (!fp) {
+	::close(fd);
+	::unlink(tmppath.c_str());
+	return false;
+    }
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = TilingCache::version;
+    header.byteorder = cacheByteOrder;
+    header.fingerprint = fingerprint;
+    header.size = 0;
+
+    ok = true;
+    put(&header, sizeof(header));
+    return ok;
+}
+
+void TilingCacheWriter::put(const void* data, size_t nbytes)
+{
+    if (!ok) {
+	return;
+    }
+    if (nbytes && std::fwrite(data, 1, nbytes, fp) != nbytes) {
+	ok = false;
+	return;
+    }
+    header.size += nbytes;
+
+    static const char padding[cacheAlign] = {0};
+    const size_t npad = (cacheAlign - header.size % cacheAlign) % cacheAlign;
+    if (npad && std::fwrite(padding, 1, npad, fp) != npad) {
+	ok = false;
+	return;
+    }
+    header.size += npad;
+}
+
+bool TilingCacheWriter::commit()
+{
+    if (!fp) {
+	return false;
+    }
+    if (ok) {
+	ok = std::fseek(fp, 0, SEEK_SET) == 0
+	    && std::fwrite(&header, 1, sizeof(header), fp) == sizeof(header);
+    }
+    ok = (std::fclose(fp) == 0) && ok;
+    fp = 0;
+
+    if (ok) {
+	::chmod(tmppath.c_str(), 0644);
+	ok = ::rename(tmppath.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+	::unlink(tmppath.c_str());
+    }
+    return ok;
+}
+
+
+TilingCacheReader::TilingCacheReader(const char* begin, const char* theend)
+    : cursor(begin), end(theend)
+{
+}
+
+bool TilingCacheReader::next(size_t elsize, const char** data, size_t& n)
+{
+    if (!cursor || (size_t)(end-cursor) < sizeof(uint64_t)) {
+	return false;
+    }
+    uint64_t count = 0;
+    std::memcpy(&count, cursor, sizeof(count));
+    cursor += sizeof(uint64_t);
+
+    if (count > (uint64_t)(end-cursor)/elsize) {
+	return false;
+    }
+    const size_t nbytes = count*elsize;
+    const size_t npad = (cacheAlign - nbytes % cacheAlign) % cacheAlign;
+    if ((size_t)(end-cursor) < nbytes + npad) {
+	return false;
+    }
+
+    *data = cursor;
+    n = count;
+    cursor += nbytes + npad;
+    return true;
+}
+
+
+TilingCache::TilingCache()
+    : mem(0), memsize(0)
+{
+}
+
+TilingCache::~TilingCache()
+{
+    close();
+}
+
+uint64_t TilingCache::fingerprint(const GeomDataSource& geo, uint32_t options)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hashValue(hash, version);
+    hashValue(hash, options);
+
+    std::vector<double> ext = geo.extent();
+    hashValue(hash, (uint64_t)ext.size());
+    for (size_t ind = 0; ind < ext.size(); ++ind) {
+	hashValue(hash, ext[ind]);
+    }
+
+    const WirePlaneType_t planes[3] = {kUwire, kVwire, kYwire};
+    for (int ind = 0; ind < 3; ++ind) {
+	hashValue(hash, geo.pitch(planes[ind]));
+	hashValue(hash, geo.angle(planes[ind]));
+	hashValue(hash, (uint64_t)geo.wires_in_plane(planes[ind]).size());
+    }
+
+    std::pair<double,double> YwireZminmax = geo.minmax(2, kYwire);
+    hashValue(hash, YwireZminmax.first);
+    hashValue(hash, YwireZminmax.second);
+
+    return hash;
+}
+
+std::string TilingCache::filename(const std::string& directory, uint64_t fingerprint)
+{
+    std::stringstream ss;
+    ss << directory;
+    if (!directory.empty() && directory[directory.size()-1] != '/') {
+	ss << "/";
+    }
+    ss << "wcptiling-" << std::hex << std::setw(16) << std::setfill('0') << fingerprint << ".bin";
+    return ss.str();
+}
+
+bool TilingCache::open(const std::string& path, uint64_t fingerprint)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+	return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TilingCacheHeader)) {
+	::close(fd);
+	return false;
+    }
+    void* addr = ::mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+	return false;
+    }
+    mem = static_cast<const char*>(addr);
+    memsize = st.st_size;
+
+    TilingCacheHeader header;
+    std::memcpy(&header, mem, sizeof(header));
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0
+	|| header.version != version
+	|| header.byteorder != cacheByteOrder
+	|| header.fingerprint != fingerprint
+	|| header.size != memsize) {
+	close();
+	return false;
+    }
+    return true;
+}
+
+void TilingCache::close()
+{
+    if (mem) {
+	::munmap(const_cast<char*>(mem), memsize);
+    }
+    mem = 0;
+    memsize = 0;
+}
+
+TilingCacheReader TilingCache::reader() const
+{
+    if (!mem) {
+	return TilingCacheReader();
+    }
+    return TilingCacheReader(mem + sizeof(TilingCacheHeader), mem + memsize);
+}
@@ -0,0 +1,116 @@
+#include "WCPTiling/WireCellResponse.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+void SparseMatrixView::expandRows(int* rows) const
+{
+    for (int row = 0; row < nrows; ++row) {
+	for (int ind = offset[row]; ind < offset[row+1]; ++ind) {
+	    rows[ind - offset[0]] = row;
+	}
+    }
+}
+
+SparseMatrixView WireCellSubset::byWire() const
+{
+    SparseMatrixView view;
+    view.nrows = wires.size();
+    view.ncols = cells.size();
+    view.offset = wireOffset.data();
+    view.column = wireCells.data();
+    view.weight = weight.data();
+    return view;
+}
+
+SparseMatrixView WireCellSubset::byCell() const
+{
+    SparseMatrixView view;
+    view.nrows = cells.size();
+    view.ncols = wires.size();
+    view.offset = cellOffset.data();
+    view.column = cellWires.data();
+    view.weight = weight.data();
+    return view;
+}
+
+WireCellResponse::WireCellResponse(const TileMaker& tiling)
+    : index(tiling.cellWireIndex())
+{
+    ones.assign(index.wireCellOffsets()[index.nwires()], 1.0);
+}
+
+WireCellResponse::~WireCellResponse()
+{
+}
+
+SparseMatrixView WireCellResponse::full() const
+{
+    SparseMatrixView view;
+    view.nrows = index.nwires();
+    view.ncols = index.ncells();
+    view.offset = index.wireCellOffsets();
+    view.column = index.wireCells();
+    view.weight = ones.data();
+    return view;
+}
+
+void WireCellResponse::select(const int* cells, size_t n, WireCellSubset& subset) const
+{
+    subset.cells.assign(cells, cells+n);
+    subset.wires.clear();
+    if (subset.wireLocal.size() != (size_t)index.nwires()) {
+	subset.wireLocal.assign(index.nwires(), -1);
+    }
+    int* wireLocal = subset.wireLocal.data();
+
+    // Cells by wires, numbering wires as they are first met
+    subset.cellOffset.resize(n+1);
+    subset.cellWires.clear();
+    subset.cellOffset[0] = 0;
+    for (size_t col = 0; col < n; ++col) {
+	const int* cw = index.cellWires(cells[col]);
+	int local[3], nlocal = 0;
+	for (int ind = 0; ind < 3; ++ind) {
+	    if (cw[ind] < 0) {
+		continue;
+	    }
+	    if (wireLocal[cw[ind]] < 0) {
+		wireLocal[cw[ind]] = subset.wires.size();
+		subset.wires.push_back(cw[ind]);
+	    }
+	    local[nlocal++] = wireLocal[cw[ind]];
+	}
+	// Keep the columns of the row ascending
+	for (int ind = 1; ind < nlocal; ++ind) {
+	    for (int back = ind; back > 0 && local[back-1] > local[back]; --back) {
+		std::swap(local[back-1], local[back]);
+	    }
+	}
+	subset.cellWires.insert(subset.cellWires.end(), local, local+nlocal);
+	subset.cellOffset[col+1] = subset.cellWires.size();
+    }
+
+    // Wires by cells, the transpose, filled in cell order
+    const size_t nrows = subset.wires.size();
+    subset.wireOffset.assign(nrows+1, 0);
+    for (size_t ind = 0; ind < subset.cellWires.size(); ++ind) {
+	++subset.wireOffset[subset.cellWires[ind]+1];
+    }
+    for (size_t row = 0; row < nrows; ++row) {
+	subset.wireOffset[row+1] += subset.wireOffset[row];
+    }
+    subset.wireCells.resize(subset.cellWires.size());
+    subset.rowFill.assign(subset.wireOffset.begin(), subset.wireOffset.end()-1);
+    for (size_t col = 0; col < n; ++col) {
+	for (int ind = subset.cellOffset[col]; ind < subset.cellOffset[col+1]; ++ind) {
+	    subset.wireCells[subset.rowFill[subset.cellWires[ind]]++] = col;
+	}
+    }
+    for (size_t row = 0; row < nrows; ++row) {
+	wireLocal[subset.wires[row]] = -1;
+    }
+
+    subset.weight.assign(subset.cellWires.size(), 1.0);
+}
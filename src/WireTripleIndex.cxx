@@ -0,0 +1,151 @@
+#include "WCPTiling/WireTripleIndex.h"
+#include "WCPTiling/TilingCache.h"
+
+using namespace WCP;
+
+static const int indexBits = 21;
+static const int indexBias = 1 << (indexBits-1);
+static const int indexLimit = 1 << indexBits;
+
+// Lookups are done in blocks so the table slots of a whole block
+// can be requested from memory before any is probed.
+static const size_t lookupBlock = 16;
+
+const uint64_t WireTripleIndex::emptyKey;
+
+WireTripleIndex::WireTripleIndex()
+    : mask(0), ncells(0)
+{
+}
+
+WireTripleIndex::~WireTripleIndex()
+{
+}
+
+uint64_t WireTripleIndex::pack(int uindex, int vindex, int yindex)
+{
+    const unsigned int u = uindex + indexBias;
+    const unsigned int v = vindex + indexBias;
+    const unsigned int y = yindex + indexBias;
+    if (u >= (unsigned int)indexLimit || v >= (unsigned int)indexLimit || y >= (unsigned int)indexLimit) {
+	return emptyKey;
+    }
+    return (uint64_t(u) << (2*indexBits)) | (uint64_t(v) << indexBits) | uint64_t(y);
+}
+
+size_t WireTripleIndex::slot(uint64_t key) const
+{
+    // splitmix64 finalizer
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key & mask;
+}
+
+void WireTripleIndex::build(const CellStore& store)
+{
+    ncells = store.size();
+
+    size_t capacity = 16;
+    while (capacity < 2*(size_t)ncells) {
+	capacity *= 2;
+    }
+    mask = capacity-1;
+    slotKey.assign(capacity, emptyKey);
+    slotCell.assign(capacity, -1);
+    uint64_t* keys = slotKey.mutable_data();
+    int* cells = slotCell.mutable_data();
+
+    for (int cell = 0; cell < ncells; ++cell) {
+	const uint64_t key = pack(store.uindex(cell), store.vindex(cell), store.yindex(cell));
+	if (key == emptyKey) {
+	    continue;
+	}
+	size_t ind = slot(key);
+	while (keys[ind] != emptyKey && keys[ind] != key) {
+	    ind = (ind+1) & mask;
+	}
+	if (keys[ind] == emptyKey) { // first cell wins a repeated triple
+	    keys[ind] = key;
+	    cells[ind] = cell;
+	}
+    }
+}
+
+int WireTripleIndex::find(int uindex, int vindex, int yindex) const
+{
+    const uint64_t key = pack(uindex, vindex, yindex);
+    if (key == emptyKey || slotKey.empty()) {
+	return -1;
+    }
+    for (size_t ind = slot(key); slotKey[ind] != emptyKey; ind = (ind+1) & mask) {
+	if (slotKey[ind] == key) {
+	    return slotCell[ind];
+	}
+    }
+    return -1;
+}
+
+void WireTripleIndex::find(size_t n, const int* uindex, const int* vindex, const int* yindex,
+			   int* cells) const
+{
+    uint64_t keys[lookupBlock];
+    size_t slots[lookupBlock];
+
+    for (size_t first = 0; first < n; first += lookupBlock) {
+	const size_t count = (n-first < lookupBlock) ? n-first : lookupBlock;
+
+	for (size_t ind = 0; ind < count; ++ind) {
+	    keys[ind] = pack(uindex[first+ind], vindex[first+ind], yindex[first+ind]);
+	    slots[ind] = 0;
+	    if (keys[ind] != emptyKey && !slotKey.empty()) {
+		slots[ind] = slot(keys[ind]);
+		__builtin_prefetch(&slotKey[slots[ind]]);
+		__builtin_prefetch(&slotCell[slots[ind]]);
+	    }
+	}
+
+	for (size_t ind = 0; ind < count; ++ind) {
+	    int found = -1;
+	    if (keys[ind] != emptyKey && !slotKey.empty()) {
+		for (size_t at = slots[ind]; slotKey[at] != emptyKey; at = (at+1) & mask) {
+		    if (slotKey[at] == keys[ind]) {
+			found = slotCell[at];
+			break;
+		    }
+		}
+	    }
+	    cells[first+ind] = found;
+	}
+    }
+}
+
+size_t WireTripleIndex::memory() const
+{
+    return slotKey.memory() + slotCell.memory();
+}
+
+void WireTripleIndex::save(TilingCacheWriter& out) const
+{
+    const uint64_t sizes[2] = {(uint64_t)mask, (uint64_t)ncells};
+    out.write(sizes, 2);
+    out.write(slotKey);
+    out.write(slotCell);
+}
+
+bool WireTripleIndex::load(TilingCacheReader& in)
+{
+    uint64_t sizes[2] = {0, 0};
+    bool ok = in.read(sizes, 2) && in.read(slotKey) && in.read(slotCell);
+
+    mask = sizes[0];
+    ncells = sizes[1];
+    ok = ok && slotKey.size() == mask+1 && slotCell.size() == slotKey.size()
+	&& (slotKey.size() & mask) == 0;
+    if (!ok) {
+	build(CellStore());
+    }
+    return ok;
+}
@@ -0,0 +1,28 @@
+#ifndef WIRECELL_TILINGTESTGEOMETRY_H
+#define WIRECELL_TILINGTESTGEOMETRY_H
+
+// Helpers shared by the tiling tests, which tile the synthetic
+// geometry TilingBenchmark sweeps over.
+
+#include "WCPTiling/SyntheticGeometry.h"
+
+#include "WCPData/Units.h"
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+namespace WCP {
+
+// Fail the test with a message unless ok.
+inline void require(bool ok, const char* what)
+{
+    if (!ok) {
+	std::cerr << "FAILED: " << what << std::endl;
+	exit(1);
+    }
+}
+
+}
+#endif
@@ -0,0 +1,101 @@
+// Blobs found with the union-find, on one thread or several, are the
+// connected clusters a breadth-first search of the cell graph finds,
+// numbered the same way, and the graph they are found on is
+// symmetric.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+#include "WCPTiling/BlobFinder.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+// Label the cells by searching the graph from each unlabeled cell in
+// list order.
+static int searchBlobs(const CellGraph& graph, const std::vector<int>& cells, std::vector<int>& labels)
+{
+    std::vector<int> local(graph.ncells(), -1);
+    for (size_t ind = 0; ind < cells.size(); ++ind) {
+	local[cells[ind]] = ind;
+    }
+    labels.assign(cells.size(), -1);
+    int nblobs = 0;
+    std::vector<int> queue;
+    for (size_t ind = 0; ind < cells.size(); ++ind) {
+	if (labels[ind] >= 0) {
+	    continue;
+	}
+	labels[ind] = nblobs;
+	queue.assign(1, ind);
+	for (size_t next = 0; next < queue.size(); ++next) {
+	    const int cell = cells[queue[next]];
+	    for (const int* it = graph.neighborsBegin(cell); it != graph.neighborsEnd(cell); ++it) {
+		const int other = local[*it];
+		if (other >= 0 && labels[other] < 0) {
+		    labels[other] = nblobs;
+		    queue.push_back(other);
+		}
+	    }
+	}
+	++nblobs;
+    }
+    return nblobs;
+}
+
+int main()
+{
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 300, 60.0*units::degree, 3.0*units::mm, 450.0*units::mm);
+    TileMaker tiling(gds);
+    const CellGraph& graph = tiling.cellGraph();
+    require(graph.ncells() == tiling.cellStore().size(), "the graph has every cell");
+
+    for (int cell = 0; cell < graph.ncells(); ++cell) {
+	const int* begin = graph.neighborsBegin(cell);
+	const int* end = graph.neighborsEnd(cell);
+	require(std::is_sorted(begin, end), "neighbors are in ID order");
+	for (const int* it = begin; it != end; ++it) {
+	    require(*it != cell, "a cell is not its own neighbor");
+	    require(std::binary_search(graph.neighborsBegin(*it), graph.neighborsEnd(*it), cell),
+		    "a neighbor's neighbors hold the cell");
+	}
+    }
+
+    // Lists of fired cells, in a scrambled order, from a few cells to
+    // enough to be joined on every thread
+    const int percents[4] = {1, 30, 60, 100};
+    unsigned int seed = 11;
+    BlobFinder serialFinder(tiling, 1), threadedFinder(tiling, 4);
+    for (int ipercent = 0; ipercent < 4; ++ipercent) {
+	std::vector<int> cells;
+	for (int cell = 0; cell < graph.ncells(); ++cell) {
+	    seed = 1664525*seed + 1013904223;
+	    if ((seed >> 8) % 100 < (unsigned int)percents[ipercent]) {
+		cells.push_back(cell);
+	    }
+	}
+	for (size_t ind = cells.size(); ind > 1; --ind) {
+	    seed = 1664525*seed + 1013904223;
+	    std::swap(cells[ind-1], cells[(seed >> 8) % ind]);
+	}
+	if (percents[ipercent] >= 30) {
+	    require(cells.size() >= 4*4096, "the list is long enough to be joined on threads");
+	}
+
+	std::vector<int> expected;
+	const int nexpected = searchBlobs(graph, cells, expected);
+	BlobFinder* finders[2] = {&serialFinder, &threadedFinder};
+	for (int ifinder = 0; ifinder < 2; ++ifinder) {
+	    // Twice, so the finder's scratch space is reused
+	    for (int repeat = 0; repeat < 2; ++repeat) {
+		std::vector<int> labels(cells.size(), -1);
+		const int nblobs = finders[ifinder]->find(cells.data(), cells.size(), labels.data());
+		require(nblobs == nexpected, "the finder finds as many blobs as the search");
+		require(labels == expected, "the finder labels cells as the search does");
+	    }
+	}
+    }
+    return 0;
+}
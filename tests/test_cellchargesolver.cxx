@@ -0,0 +1,106 @@
+// The charge solver reproduces wire charges made by a few true cells
+// among the ghosts their wires form, keeps charges non-negative,
+// starts warm from its last solve and gives the same answer on
+// several threads.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+#include "WCPTiling/CellCoincidence.h"
+#include "WCPTiling/CellChargeSolver.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+// Wire charges of the true cells and the cells their wires make
+struct Problem {
+    std::vector<float> charge[3];
+    std::vector<int> cells;
+};
+
+static void makeProblem(const TileMaker& tiling, const CellCoincidence& coincidence, int numTrue,
+			Problem& problem)
+{
+    const CellStore& store = tiling.cellStore();
+    const WirePlaneType_t planes[3] = {kUwire, kVwire, kYwire};
+    std::vector<uint64_t> fired[3];
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	problem.charge[iplane].assign(coincidence.nwires(planes[iplane]), 0.0);
+	fired[iplane].assign(coincidence.nwords(planes[iplane]), 0);
+    }
+    for (int ind = 0; ind < numTrue; ++ind) {
+	const int cell = (long)(2*ind+1)*store.size()/(2*numTrue);
+	const int windex[3] = {store.uindex(cell), store.vindex(cell), store.yindex(cell)};
+	for (int iplane = 0; iplane < 3; ++iplane) {
+	    if (windex[iplane] >= 0 && windex[iplane] < coincidence.nwires(planes[iplane])) {
+		problem.charge[iplane][windex[iplane]] += 10.0 + ind % 7;
+		fired[iplane][windex[iplane]/64] |= uint64_t(1) << (windex[iplane]%64);
+	    }
+	}
+    }
+    problem.cells.clear();
+    coincidence.find(fired[0].data(), fired[1].data(), fired[2].data(), problem.cells);
+}
+
+static const std::vector<double>& solve(CellChargeSolver& solver, const Problem& problem)
+{
+    return solver.solve(problem.cells.data(), problem.cells.size(), problem.charge[0].data(),
+			problem.charge[1].data(), problem.charge[2].data());
+}
+
+int main()
+{
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 100, 60.0*units::degree, 3.0*units::mm, 150.0*units::mm);
+    TileMaker tiling(gds);
+    CellCoincidence coincidence(tiling);
+
+    Problem sparse;
+    makeProblem(tiling, coincidence, 20, sparse);
+    require(sparse.cells.size() >= 20, "the true cells are among the candidates");
+
+    CellChargeSolverOptions options;
+    options.maxIterations = 5000;
+    options.tolerance = 1e-3;
+    CellChargeSolver solver(tiling, options);
+    const std::vector<double> cold = solve(solver, sparse);
+    const CellChargeSolverStats coldStats = solver.stats();
+    require(cold.size() == sparse.cells.size(), "one charge per cell");
+    require(coldStats.warmCells == 0, "the first solve starts cold");
+    require(coldStats.converged, "the solve converges");
+    require(coldStats.residual < 0.05, "the wire charges are reproduced");
+    for (size_t ind = 0; ind < cold.size(); ++ind) {
+	require(cold[ind] >= 0.0, "charges are not negative");
+    }
+
+    // Solving again starts from the answer and needs fewer steps
+    const std::vector<double> warm = solve(solver, sparse);
+    const CellChargeSolverStats warmStats = solver.stats();
+    require(warmStats.warmCells == (int)sparse.cells.size(), "every cell starts warm");
+    require(warmStats.converged && 2*warmStats.iterations < coldStats.iterations,
+	    "a warm start takes fewer iterations");
+    require(warmStats.residual <= coldStats.residual*1.01, "a warm start is as good");
+
+    CellChargeSolverOptions coldOptions = options;
+    coldOptions.warmStart = false;
+    CellChargeSolver coldSolver(tiling, coldOptions);
+    solve(coldSolver, sparse);
+    solve(coldSolver, sparse);
+    require(coldSolver.stats().warmCells == 0, "without warm starts every solve is cold");
+
+    // A problem large enough to be split over threads
+    Problem dense;
+    makeProblem(tiling, coincidence, 400, dense);
+    CellChargeSolverOptions serialOptions = options;
+    serialOptions.maxIterations = 200;
+    serialOptions.tolerance = 0.0;
+    CellChargeSolverOptions threadedOptions = serialOptions;
+    threadedOptions.nthreads = 4;
+    CellChargeSolver serialSolver(tiling, serialOptions), threadedSolver(tiling, threadedOptions);
+    const std::vector<double> serial = solve(serialSolver, dense);
+    const std::vector<double> threaded = solve(threadedSolver, dense);
+    require(serialSolver.subset().byWire().nnz() >= (1 << 14), "the dense problem is solved on threads");
+    require(serial == threaded, "threads give the serial charges");
+    return 0;
+}
@@ -0,0 +1,139 @@
+// Charges deposited on one thread or several give the totals of
+// locating each point and summing its charge into its cell and that
+// cell's wires, across calls and after a clear.  The charges are
+// whole numbers so every order of addition sums them exactly.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+#include "WCPTiling/ChargeDeposition.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+// What the points deposit, summed one by one
+struct Totals {
+    std::vector<double> cell;
+    std::vector<double> wire[3];
+    std::vector<int> cells;
+    size_t missed;
+};
+
+static void sumPoints(const TileMaker& tiling, const std::vector<double>& Yval, const std::vector<double>& Zval,
+		      const std::vector<float>& charge, Totals& totals)
+{
+    const CellStore& store = tiling.cellStore();
+    const CellWireIndex& index = tiling.cellWireIndex();
+    const WirePlaneType_t planes[3] = {kUwire, kVwire, kYwire};
+    totals.cell.assign(store.size(), 0.0);
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	totals.wire[iplane].assign(index.nwires(planes[iplane]), 0.0);
+    }
+    totals.cells.clear();
+    totals.missed = 0;
+    for (size_t ind = 0; ind < Yval.size(); ++ind) {
+	const int cell = tiling.locate(Yval[ind], Zval[ind]);
+	if (cell < 0) {
+	    ++totals.missed;
+	    continue;
+	}
+	totals.cell[cell] += charge[ind];
+	totals.cells.push_back(cell);
+	const int windex[3] = {store.uindex(cell), store.vindex(cell), store.yindex(cell)};
+	for (int iplane = 0; iplane < 3; ++iplane) {
+	    if (windex[iplane] >= 0 && windex[iplane] < (int)totals.wire[iplane].size()) {
+		totals.wire[iplane][windex[iplane]] += charge[ind];
+	    }
+	}
+    }
+    std::sort(totals.cells.begin(), totals.cells.end());
+    totals.cells.erase(std::unique(totals.cells.begin(), totals.cells.end()), totals.cells.end());
+}
+
+static void requireTotals(const ChargeDeposition& deposition, const Totals& totals, size_t npoints)
+{
+    const WirePlaneType_t planes[3] = {kUwire, kVwire, kYwire};
+    require(deposition.npoints() == npoints, "every point is counted");
+    require(deposition.nmissed() == totals.missed, "the points in no cell are counted");
+    require(deposition.cells() == totals.cells, "the cells given charge are listed in order");
+    for (size_t cell = 0; cell < totals.cell.size(); ++cell) {
+	require(deposition.cellCharge(cell) == totals.cell[cell], "each cell holds its points' charge");
+    }
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	require(deposition.wireCharge(planes[iplane]) == totals.wire[iplane], "each wire holds its cells' charge");
+    }
+}
+
+int main()
+{
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 100, 60.0*units::degree, 3.0*units::mm, 150.0*units::mm);
+    TileMaker tiling(gds);
+    const CellStore& store = tiling.cellStore();
+
+    double minY = store.vertexY(0,0), maxY = minY, minZ = store.vertexZ(0,0), maxZ = minZ;
+    for (int cell = 0; cell < store.size(); ++cell) {
+	for (int ind = 0; ind < store.nvertices(cell); ++ind) {
+	    minY = std::min(minY, store.vertexY(cell,ind));
+	    maxY = std::max(maxY, store.vertexY(cell,ind));
+	    minZ = std::min(minZ, store.vertexZ(cell,ind));
+	    maxZ = std::max(maxZ, store.vertexZ(cell,ind));
+	}
+    }
+
+    // Points in short tracks, so runs of them share a cell, some
+    // beyond the tiling, in two batches each long enough for threads
+    std::vector<double> Yval[2], Zval[2];
+    std::vector<float> charge[2];
+    const double away = 5.0*units::mm;
+    unsigned int seed = 3;
+    for (int batch = 0; batch < 2; ++batch) {
+	double Y = 0.0, Z = 0.0;
+	for (int ind = 0; ind < 50000; ++ind) {
+	    seed = 1664525*seed + 1013904223;
+	    const double step = ((seed >> 8) & 0xffff)/65535.0;
+	    if (ind % 8 == 0) {
+		Y = minY - away + step*(maxY - minY + 2*away);
+		seed = 1664525*seed + 1013904223;
+		Z = minZ - away + ((seed >> 8) & 0xffff)/65535.0*(maxZ - minZ + 2*away);
+	    }
+	    else {
+		Y += 0.3*units::mm*(step - 0.5);
+		Z += 0.2*units::mm;
+	    }
+	    Yval[batch].push_back(Y);
+	    Zval[batch].push_back(Z);
+	    charge[batch].push_back(1 + (seed >> 24) % 16);
+	}
+    }
+    std::vector<double> bothY(Yval[0]), bothZ(Zval[0]);
+    std::vector<float> bothCharge(charge[0]);
+    bothY.insert(bothY.end(), Yval[1].begin(), Yval[1].end());
+    bothZ.insert(bothZ.end(), Zval[1].begin(), Zval[1].end());
+    bothCharge.insert(bothCharge.end(), charge[1].begin(), charge[1].end());
+
+    Totals first, both;
+    sumPoints(tiling, Yval[0], Zval[0], charge[0], first);
+    sumPoints(tiling, bothY, bothZ, bothCharge, both);
+    require(first.missed > 0 && first.missed < Yval[0].size()/2, "some points are outside the tiling");
+
+    const int nthreads[2] = {1, 4};
+    for (int ind = 0; ind < 2; ++ind) {
+	ChargeDeposition deposition(tiling, nthreads[ind]);
+	for (int repeat = 0; repeat < 2; ++repeat) {
+	    const size_t missed = deposition.deposit(Yval[0].size(), Yval[0].data(), Zval[0].data(), charge[0].data());
+	    require(missed == first.missed, "deposit returns the points in no cell");
+	    requireTotals(deposition, first, Yval[0].size());
+	    deposition.deposit(Yval[1].size(), Yval[1].data(), Zval[1].data(), charge[1].data());
+	    requireTotals(deposition, both, bothY.size());
+
+	    // Clearing zeroes every total, so depositing again starts over
+	    deposition.clear();
+	    Totals none;
+	    sumPoints(tiling, std::vector<double>(), std::vector<double>(), std::vector<float>(), none);
+	    requireTotals(deposition, none, 0);
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Cells clipped at the edges of the active area stay inside it, the
+// corner cells reach its corners, and the cells together cover it:
+// their areas sum to the area of the rectangle.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+
+using namespace WCP;
+
+static void testTiling(double angle)
+{
+    const int numYwires = 100;
+    const double pitch = 3.0*units::mm, height = 150.0*units::mm;
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, numYwires, angle*units::degree, pitch, height);
+
+    // The active area starts in Z where the Y wires do and is a
+    // pitch wide per Y wire.  In Y it spans the wires' extent.
+    const double left = gds.minmax(2, kYwire).first, right = left + numYwires*pitch;
+    TileMaker tiling(gds);
+    const CellStore& store = tiling.cellStore();
+    require(tiling.stats().cellsTrimmed > 0, "some cells are clipped");
+
+    const double tolerance = 1e-9*units::mm;
+    double total = 0.0;
+    for (int cell = 0; cell < store.size(); ++cell) {
+	require(store.nvertices(cell) >= 3, "every cell is a polygon");
+	for (int ind = 0; ind < store.nvertices(cell); ++ind) {
+	    const double Z = store.vertexZ(cell,ind), Y = store.vertexY(cell,ind);
+	    require(Z > left-tolerance && Z < right+tolerance && Y > -tolerance && Y < height+tolerance,
+		    "every vertex is inside the active area");
+	}
+	require(store.area(cell) > 0.0, "every cell has an area");
+	total += store.area(cell);
+    }
+    require(std::abs(total - (right-left)*height) < 1e-9*(right-left)*height, "the cells cover the active area");
+
+    // The cell just inside each corner has a vertex at the corner
+    const double cornerY[4] = {0.0, 0.0, height, height}, cornerZ[4] = {left, right, left, right};
+    const double inward = 0.01*units::mm;
+    for (int corner = 0; corner < 4; ++corner) {
+	const double Y = cornerY[corner] + (cornerY[corner] > 0.0 ? -inward : inward);
+	const double Z = cornerZ[corner] + (cornerZ[corner] == right ? -inward : inward);
+	const int cell = tiling.locate(Y, Z);
+	require(cell >= 0, "each corner is in a cell");
+	bool reached = false;
+	for (int ind = 0; ind < store.nvertices(cell); ++ind) {
+	    reached = reached || (std::abs(store.vertexZ(cell,ind) - cornerZ[corner]) < tolerance
+				  && std::abs(store.vertexY(cell,ind) - cornerY[corner]) < tolerance);
+	}
+	require(reached, "each corner cell is clipped to the corner");
+    }
+}
+
+int main()
+{
+    const double angles[5] = {30.0, 35.7, 45.0, 60.0, 72.0};
+    for (int ind = 0; ind < 5; ++ind) {
+	testTiling(angles[ind]);
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+// A compacted store gives each cell the wires, vertices, center and
+// area of the explicit store, the vertices to within the shape
+// tolerance, and cells added after compacting are kept explicitly
+// without disturbing the shared ones.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+
+using namespace WCP;
+
+// The cell of store1 is the cell of store2, to within tolerance.
+static void requireSameCell(const CellStore& store1, int cell1, const CellStore& store2, int cell2,
+			    double tolerance)
+{
+    require(store1.uindex(cell1) == store2.uindex(cell2) && store1.vindex(cell1) == store2.vindex(cell2)
+	    && store1.yindex(cell1) == store2.yindex(cell2), "each cell has the same wires");
+    require(store1.nvertices(cell1) == store2.nvertices(cell2), "each cell has as many vertices");
+    for (int ind = 0; ind < store1.nvertices(cell1); ++ind) {
+	require(std::abs(store1.vertexZ(cell1,ind) - store2.vertexZ(cell2,ind)) <= tolerance
+		&& std::abs(store1.vertexY(cell1,ind) - store2.vertexY(cell2,ind)) <= tolerance,
+		"each vertex is in the same place");
+    }
+    require(store1.centerZ(cell1) == store2.centerZ(cell2) && store1.centerY(cell1) == store2.centerY(cell2),
+	    "each cell has the same center");
+    require(std::abs(store1.area(cell1) - store2.area(cell2)) <= tolerance*units::mm,
+	    "each cell has the same area");
+}
+
+static void testTiling(double angle)
+{
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 200, angle*units::degree, 3.0*units::mm, 300.0*units::mm);
+    TileMakerOptions exact, compact;
+    compact.compactCells = true;
+    TileMaker exactTiling(gds, exact), compactTiling(gds, compact);
+
+    const CellStore& explicitStore = exactTiling.cellStore();
+    const CellStore& compactStore = compactTiling.cellStore();
+    require(!explicitStore.compacted() && compactStore.compacted(), "only the compact tiling has shapes");
+    require(compactStore.nshapes() > 0 && compactStore.nshapes() < compactStore.size()/2,
+	    "most cells share a shape");
+    require(compactStore.size() == explicitStore.size(), "compacting keeps every cell");
+    const double tolerance = 1e-6*units::mm;
+    int shared = 0;
+    for (int cell = 0; cell < compactStore.size(); ++cell) {
+	shared += compactStore.shape(cell) >= 0;
+	requireSameCell(compactStore, cell, explicitStore, cell, tolerance);
+    }
+    require(shared > compactStore.size()/2, "most cells refer to a shape");
+
+    // Cells added after compacting, copied from cells of the tiling,
+    // are explicit and leave the others as they were
+    CellStore grown = compactStore;
+    const int copied[3] = {0, explicitStore.size()/2, explicitStore.size()-1};
+    for (int ind = 0; ind < 3; ++ind) {
+	const int cell = copied[ind];
+	std::vector<std::pair<double,double> > vertices;
+	for (int vtx = 0; vtx < explicitStore.nvertices(cell); ++vtx) {
+	    vertices.push_back(std::make_pair(explicitStore.vertexZ(cell,vtx), explicitStore.vertexY(cell,vtx)));
+	}
+	const int added = grown.add(vertices.data(), vertices.size(),
+				    std::make_pair(explicitStore.centerZ(cell), explicitStore.centerY(cell)),
+				    explicitStore.area(cell), explicitStore.uindex(cell),
+				    explicitStore.vindex(cell), explicitStore.yindex(cell));
+	require(added == compactStore.size() + ind, "an added cell takes the next ID");
+	require(grown.compacted() && grown.shape(added) < 0, "an added cell is explicit");
+	requireSameCell(grown, added, explicitStore, cell, 0.0);
+    }
+    require(grown.size() == compactStore.size() + 3 && grown.nshapes() == compactStore.nshapes(),
+	    "adding cells adds no shape");
+    for (int cell = 0; cell < compactStore.size(); ++cell) {
+	require(grown.shape(cell) == compactStore.shape(cell), "the earlier cells keep their shapes");
+	requireSameCell(grown, cell, compactStore, cell, 0.0);
+    }
+}
+
+int main()
+{
+    testTiling(60.0);
+    testTiling(45.0);
+    return 0;
+}
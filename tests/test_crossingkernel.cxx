@@ -0,0 +1,77 @@
+// The candidate vertices crossings() computes with the instruction set
+// compiled in are those of crossingsScalar() to the bit, on random
+// strips and crossings.  A default build has no vector path and
+// compares the scalar kernel with itself; build with -mavx2 -mfma or
+// -mavx512f to test the vector kernels.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/CrossingKernel.h"
+
+#include <cstring>
+#include <cstdio>
+
+using namespace WCP;
+
+static unsigned int seed = 17;
+
+static double uniform(double low, double high)
+{
+    seed = 1664525*seed + 1013904223;
+    return low + (high - low)*((seed >> 8) & 0xffffff)/double(0xffffff);
+}
+
+static bool sameBytes(const double* val1, const double* val2, int num)
+{
+    return std::memcmp(val1, val2, num*sizeof(double)) == 0;
+}
+
+int main()
+{
+    const double PI = 3.14159265358979312;
+    long cells = 0, masked = 0;
+    for (int ibatch = 0; ibatch < 20000; ++ibatch) {
+	// A strip of a geometry with U and V at their own angles
+	const double angleU = uniform(20.0, 80.0)*PI/180.0, angleV = -uniform(20.0, 80.0)*PI/180.0;
+	const double pitch = uniform(2.0, 5.0);
+	CrossingStrip strip;
+	strip.Zval = uniform(0.0, 10000.0);
+	strip.Z1 = strip.Zval - pitch/2.0;
+	strip.Z2 = strip.Zval + pitch/2.0;
+	strip.Uslope = 1.0/tan(angleU);
+	strip.Vslope = 1.0/tan(angleV);
+	strip.UhalfWidth = std::abs(pitch/sin(angleU))/2.0;
+	strip.VhalfWidth = std::abs(pitch/sin(angleV))/2.0;
+	strip.epsilon = 1e-10;
+
+	// Crossings near enough to each other to form cells
+	CrossingBatch batch;
+	batch.size = 1 + ibatch % CrossingBatch::capacity;
+	for (int ind = 0; ind < batch.size; ++ind) {
+	    batch.Uval[ind] = uniform(0.0, 5000.0);
+	    batch.Vval[ind] = batch.Uval[ind] + uniform(-2.0, 2.0)*(strip.UhalfWidth + strip.VhalfWidth);
+	}
+	CrossingBatch scalar = batch;
+	crossings(strip, batch);
+	crossingsScalar(strip, scalar);
+
+	for (int ind = 0; ind < batch.size; ++ind) {
+	    ++cells;
+	    masked += batch.mask[ind] != 0;
+	    require(batch.mask[ind] == scalar.mask[ind], "the kernels choose the same vertices");
+	    require(sameBytes(&batch.UVminZ[ind], &scalar.UVminZ[ind], 1)
+		    && sameBytes(&batch.UVmaxZ[ind], &scalar.UVmaxZ[ind], 1)
+		    && sameBytes(&batch.UVminY[ind], &scalar.UVminY[ind], 1)
+		    && sameBytes(&batch.UVmaxY[ind], &scalar.UVmaxY[ind], 1),
+		    "the kernels bound the U/V corners the same");
+	    for (int k = 0; k < CrossingBatch::kNumCandidates; ++k) {
+		require(sameBytes(&batch.Z[k][ind], &scalar.Z[k][ind], 1)
+			&& sameBytes(&batch.Y[k][ind], &scalar.Y[k][ind], 1),
+			"the kernels compute the same candidates");
+	    }
+	}
+    }
+    require(masked > cells/2, "most cells have vertices");
+    std::printf("%ld cells compared using %s\n", cells, crossingsInstructionSet());
+    return 0;
+}
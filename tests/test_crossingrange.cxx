@@ -0,0 +1,92 @@
+// The closed form range of V crossings crossingRange() gives each U
+// crossing holds every V crossing formsCell() accepts for it, on every
+// chain, including at the bottom and top edges where the range is
+// trimmed and above the U crossings the chains start from.  The
+// accepted crossings are one run, as the chain scan assumes, and the
+// range is at most a crossing wider than it at either end.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+
+using namespace WCP;
+
+namespace WCP {
+
+    // Counts of the U crossings checked
+    struct RangeCounts {
+	long crossings;		// U crossings checked
+	long forming;		// of those, forming a cell
+	long trimmedBelow;	// forming ones whose range was trimmed at the bottom
+	long trimmedAbove;	// and at the top
+	long skipped;		// above the first U crossing a chain scans
+    };
+
+    struct TileMakerProbe {
+	static void check(const TileMaker& tiling, RangeCounts& counts) {
+	    for (size_t ind = 0; ind < tiling.Ywires.size(); ++ind) {
+		double Zval = 0, YvalOffsetU = 0, YvalOffsetV = 0;
+		tiling.chainOffsets(ind, Zval, YvalOffsetU, YvalOffsetV);
+		checkChain(tiling, YvalOffsetU, YvalOffsetV, counts);
+	    }
+	}
+
+	// As constructCellChain() does, less building the cells
+	static void checkChain(const TileMaker& tiling, double YvalOffsetU, double YvalOffsetV,
+			       RangeCounts& counts) {
+	    const double Uspacing = tiling.UspacingOnWire, Vspacing = tiling.VspacingOnWire;
+	    const double maxHeight = tiling.maxHeight, epsilon = 1e-10;
+	    const int numUcrosses = std::ceil(((tiling.UdeltaY-Uspacing)/2.0+YvalOffsetU)/Uspacing)+1;
+	    const int numVcrosses = std::ceil((maxHeight-(tiling.VdeltaY+Vspacing)/2.0-YvalOffsetV)/Vspacing)+1;
+	    const double Umax = maxHeight + Vspacing + tiling.crossingHalfWidth;
+	    const int firstU = YvalOffsetU > Umax ? std::floor((YvalOffsetU-Umax)/Uspacing) : 0;
+
+	    for (int indU = 0; indU < numUcrosses; ++indU) {
+		const double UwireYval = YvalOffsetU-indU*Uspacing;
+
+		// Every V crossing, in order
+		int first = -1, last = -1, runs = 0;
+		for (int indV = 0; indV < numVcrosses; ++indV) {
+		    if (tiling.formsCell(UwireYval, YvalOffsetV+indV*Vspacing)) {
+			runs += last != indV-1 || first < 0;
+			first = first < 0 ? indV : first;
+			last = indV;
+		    }
+		}
+		++counts.crossings;
+		require(runs <= 1, "the V crossings forming a cell are one run");
+
+		int indVmin = 0, indVmax = 0;
+		const bool some = tiling.crossingRange(UwireYval, YvalOffsetV, numVcrosses, indVmin, indVmax);
+		if (indU < firstU) {
+		    require(first < 0, "the U crossings a chain skips form no cell");
+		    ++counts.skipped;
+		}
+		if (first < 0) {
+		    continue;
+		}
+		++counts.forming;
+		require(some && indVmin <= first && last <= indVmax, "the range holds every V crossing forming a cell");
+		require(first - indVmin <= 1 && indVmax - last <= 1, "the range is at most a crossing too wide");
+		counts.trimmedBelow += UwireYval+Uspacing/2.0 < -1.0*epsilon;
+		counts.trimmedAbove += UwireYval-Uspacing/2.0 > maxHeight;
+	    }
+	}
+    };
+
+}
+
+int main()
+{
+    const double angles[5] = {30.0, 35.7, 45.0, 60.0, 72.0};
+    for (int ind = 0; ind < 5; ++ind) {
+	GeomDataSource gds;
+	makeSyntheticGeometry(gds, 100, angles[ind]*units::degree, 3.0*units::mm, 150.0*units::mm);
+	TileMaker tiling(gds);
+	RangeCounts counts = {0, 0, 0, 0, 0};
+	TileMakerProbe::check(tiling, counts);
+	require(counts.forming > 0 && counts.trimmedBelow > 0 && counts.trimmedAbove > 0,
+		"ranges are checked inside and at both edges");
+    }
+    return 0;
+}
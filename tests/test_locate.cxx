@@ -0,0 +1,93 @@
+// Every cell's center locates to the cell, every vertex to a cell
+// holding it to within the locate tolerance, and points outside the
+// tiling to none.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+// True if the point is inside the cell or within tolerance of it.
+static bool holds(const CellStore& store, int cell, double Yval, double Zval, double tolerance)
+{
+    const int num = store.nvertices(cell);
+    bool left = false, right = false;
+    for (int ind = 0; ind < num; ++ind) {
+	const int next = (ind+1) % num;
+	const double Z1 = store.vertexZ(cell,ind), Y1 = store.vertexY(cell,ind);
+	const double dZ = store.vertexZ(cell,next) - Z1, dY = store.vertexY(cell,next) - Y1;
+	const double cross = dZ*(Yval-Y1) - dY*(Zval-Z1);
+	const double reach = tolerance*std::sqrt(dZ*dZ + dY*dY);
+	left = left || cross < -reach;
+	right = right || cross > reach;
+    }
+    return !(left && right);
+}
+
+static void testTiling(double angle)
+{
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 100, angle*units::degree, 3.0*units::mm, 150.0*units::mm);
+    TileMaker tiling(gds);
+    const CellStore& store = tiling.cellStore();
+    const double tolerance = 1e-6*units::mm;
+
+    std::vector<double> Yval, Zval;
+    for (int cell = 0; cell < store.size(); ++cell) {
+	const int owner = tiling.cellID(store.uindex(cell), store.vindex(cell), store.yindex(cell));
+	require(tiling.locate(store.centerY(cell), store.centerZ(cell)) == owner,
+		"a cell's center locates to the cell");
+	Yval.push_back(store.centerY(cell));
+	Zval.push_back(store.centerZ(cell));
+
+	for (int ind = 0; ind < store.nvertices(cell); ++ind) {
+	    const double Y = store.vertexY(cell,ind), Z = store.vertexZ(cell,ind);
+	    const int found = tiling.locate(Y, Z);
+	    require(found >= 0 && holds(store, found, Y, Z, tolerance),
+		    "a vertex locates to a cell holding it");
+	    Yval.push_back(Y);
+	    Zval.push_back(Z);
+
+	    // Just inside the vertex is inside the cell
+	    const double inY = Y + 1e-3*(store.centerY(cell) - Y);
+	    const double inZ = Z + 1e-3*(store.centerZ(cell) - Z);
+	    require(tiling.locate(inY, inZ) == owner, "a point near a vertex locates to its cell");
+	}
+    }
+
+    // Outside the cells on each side
+    double minY = store.vertexY(0,0), maxY = minY, minZ = store.vertexZ(0,0), maxZ = minZ;
+    for (int cell = 0; cell < store.size(); ++cell) {
+	for (int ind = 0; ind < store.nvertices(cell); ++ind) {
+	    minY = std::min(minY, store.vertexY(cell,ind));
+	    maxY = std::max(maxY, store.vertexY(cell,ind));
+	    minZ = std::min(minZ, store.vertexZ(cell,ind));
+	    maxZ = std::max(maxZ, store.vertexZ(cell,ind));
+	}
+    }
+    const double midY = 0.5*(minY + maxY), midZ = 0.5*(minZ + maxZ), away = 1.0*units::mm;
+    const double outY[4] = {minY - away, maxY + away, midY, midY};
+    const double outZ[4] = {midZ, midZ, minZ - away, maxZ + away};
+    for (int ind = 0; ind < 4; ++ind) {
+	require(tiling.locate(outY[ind], outZ[ind]) == -1, "a point outside the tiling locates to none");
+	Yval.push_back(outY[ind]);
+	Zval.push_back(outZ[ind]);
+    }
+
+    std::vector<int> ids(Yval.size());
+    tiling.locate(Yval.size(), Yval.data(), Zval.data(), ids.data());
+    for (size_t ind = 0; ind < Yval.size(); ++ind) {
+	require(ids[ind] == tiling.locate(Yval[ind], Zval[ind]), "batched locate agrees with locate");
+    }
+}
+
+int main()
+{
+    testTiling(60.0);
+    testTiling(45.0);
+    testTiling(35.7);
+    return 0;
+}
@@ -0,0 +1,54 @@
+// Tilings whose chains repeat every few Y wires, and are copied
+// instead of constructed, give cell for cell the tiling constructed
+// chain by chain: the same wires, the same vertices in the same
+// order, and the same areas to within rounding.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+
+using namespace WCP;
+
+static void testTiling(double angle)
+{
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 300, angle, 3.0*units::mm, 150.0*units::mm);
+    TileMakerOptions copied, constructed;
+    copied.periodicity = true;
+    constructed.periodicity = false;
+    TileMaker copiedTiling(gds, copied), constructedTiling(gds, constructed);
+    require(copiedTiling.stats().period > 0 && copiedTiling.stats().chainsReplicated > 0,
+	    "the chains repeat and are copied");
+    require(constructedTiling.stats().chainsReplicated == 0, "without periodicity no chain is copied");
+
+    const CellStore& store1 = copiedTiling.cellStore();
+    const CellStore& store2 = constructedTiling.cellStore();
+    const double tolerance = 1e-9*units::mm;
+    require(store1.size() == store2.size(), "copying gives as many cells");
+    for (int cell = 0; cell < store1.size(); ++cell) {
+	require(store1.uindex(cell) == store2.uindex(cell) && store1.vindex(cell) == store2.vindex(cell)
+		&& store1.yindex(cell) == store2.yindex(cell), "each cell has the same wires");
+	require(store1.nvertices(cell) == store2.nvertices(cell), "each cell has as many vertices");
+	for (int ind = 0; ind < store1.nvertices(cell); ++ind) {
+	    require(std::abs(store1.vertexZ(cell,ind) - store2.vertexZ(cell,ind)) < tolerance
+		    && std::abs(store1.vertexY(cell,ind) - store2.vertexY(cell,ind)) < tolerance,
+		    "each vertex is in the same place and order");
+	}
+	require(std::abs(store1.centerZ(cell) - store2.centerZ(cell)) < tolerance
+		&& std::abs(store1.centerY(cell) - store2.centerY(cell)) < tolerance,
+		"each cell has the same center");
+	require(std::abs(store1.area(cell) - store2.area(cell)) < tolerance*units::mm,
+		"each cell has the same area");
+    }
+}
+
+int main()
+{
+    // Angles whose cosine is 1/2, 1/3, 3/4 and 4/5 repeat every 2,
+    // 3, 4 and 5 Y wires.
+    const double cosines[4] = {1.0/2.0, 1.0/3.0, 3.0/4.0, 4.0/5.0};
+    for (int ind = 0; ind < 4; ++ind) {
+	testTiling(std::acos(cosines[ind])*units::radian);
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Slices imaged on a pool of threads, stealing work from each other,
+// give exactly the cells and charges of imaging them one by one, and
+// those are the cells whose three wires fired.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+#include "WCPTiling/CellCoincidence.h"
+#include "WCPTiling/SliceImager.h"
+#include "WCPTiling/SliceExecutor.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+int main()
+{
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 100, 60.0*units::degree, 3.0*units::mm, 150.0*units::mm);
+    TileMaker tiling(gds);
+    const CellStore& store = tiling.cellStore();
+    CellCoincidence coincidence(tiling);
+    const WirePlaneType_t planes[3] = {kUwire, kVwire, kYwire};
+
+    // Slices fire from 1% to 50% of the wires so their work is uneven
+    const int numSlices = 200;
+    std::vector<float> charges[3];
+    std::vector<SliceFrame> frames(numSlices);
+    unsigned int seed = 7;
+    for (int iplane = 0; iplane < 3; ++iplane) {
+	const int nwires = coincidence.nwires(planes[iplane]);
+	charges[iplane].assign((size_t)numSlices*nwires, 0.0);
+	for (int slice = 0; slice < numSlices; ++slice) {
+	    const unsigned int percent = slice % 10 == 0 ? 50 : 1 + slice % 5;
+	    float* charge = charges[iplane].data() + (size_t)slice*nwires;
+	    for (int wire = 0; wire < nwires; ++wire) {
+		seed = 1664525*seed + 1013904223;
+		if ((seed >> 8) % 100 < percent) {
+		    charge[wire] = 1.0 + (seed >> 24);
+		}
+	    }
+	    frames[slice].slice = slice;
+	    frames[slice].charge[iplane] = charge;
+	}
+    }
+
+    SliceImager imager(tiling, coincidence);
+    std::vector<SliceCells> serial(numSlices);
+    for (int slice = 0; slice < numSlices; ++slice) {
+	const SliceFrame& frame = frames[slice];
+	imager.process(frame.slice, frame.charge[0], frame.charge[1], frame.charge[2], serial[slice]);
+
+	std::vector<int> expected;
+	for (int cell = 0; cell < store.size(); ++cell) {
+	    const int windex[3] = {store.uindex(cell), store.vindex(cell), store.yindex(cell)};
+	    bool fired = true;
+	    for (int iplane = 0; iplane < 3; ++iplane) {
+		fired = fired && windex[iplane] >= 0 && windex[iplane] < coincidence.nwires(planes[iplane])
+		    && frame.charge[iplane][windex[iplane]] > 0.0;
+	    }
+	    if (fired) {
+		expected.push_back(cell);
+	    }
+	}
+	std::vector<int> found = serial[slice].cells;
+	std::sort(found.begin(), found.end());
+	require(found == expected, "the imager finds the cells whose three wires fired");
+    }
+
+    const int nthreads[2] = {1, 4};
+    for (int ind = 0; ind < 2; ++ind) {
+	SliceExecutor executor(tiling, coincidence, nthreads[ind]);
+	for (int repeat = 0; repeat < 2; ++repeat) {
+	    std::vector<SliceCells> results;
+	    executor.process(frames, results);
+	    require(results.size() == serial.size(), "one result per frame");
+	    for (int slice = 0; slice < numSlices; ++slice) {
+		require(results[slice].slice == serial[slice].slice
+			&& results[slice].cells == serial[slice].cells
+			&& results[slice].wireCharge == serial[slice].wireCharge,
+			"the pool images each slice as the serial imager does");
+	    }
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+// The cells a TileMaker builds do not depend on the number of threads
+// or on how the U/V crossings of a chain are found.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+
+#include <cstring>
+
+using namespace WCP;
+
+static bool sameBytes(double val1, double val2)
+{
+    return std::memcmp(&val1, &val2, sizeof(double)) == 0;
+}
+
+static bool sameStore(const CellStore& store1, const CellStore& store2)
+{
+    if (store1.size() != store2.size()) {
+	return false;
+    }
+    for (int cell = 0; cell < store1.size(); ++cell) {
+	if (store1.uindex(cell) != store2.uindex(cell)
+	    || store1.vindex(cell) != store2.vindex(cell)
+	    || store1.yindex(cell) != store2.yindex(cell)
+	    || !sameBytes(store1.centerZ(cell), store2.centerZ(cell))
+	    || !sameBytes(store1.centerY(cell), store2.centerY(cell))
+	    || !sameBytes(store1.area(cell), store2.area(cell))
+	    || store1.nvertices(cell) != store2.nvertices(cell)) {
+	    return false;
+	}
+	for (int ind = 0; ind < store1.nvertices(cell); ++ind) {
+	    if (!sameBytes(store1.vertexZ(cell,ind), store2.vertexZ(cell,ind))
+		|| !sameBytes(store1.vertexY(cell,ind), store2.vertexY(cell,ind))) {
+		return false;
+	    }
+	}
+    }
+    return true;
+}
+
+int main()
+{
+    const double angles[3] = {60.0, 45.0, 35.7};
+    for (int ind = 0; ind < 3; ++ind) {
+	GeomDataSource gds;
+	makeSyntheticGeometry(gds, 100, angles[ind]*units::degree, 3.0*units::mm, 150.0*units::mm);
+
+	TileMakerOptions serial;
+	serial.nthreads = 1;
+	TileMaker tiling(gds, serial);
+	require(tiling.cellStore().size() > 0, "cells are made");
+
+	TileMakerOptions threaded = serial;
+	threaded.nthreads = 4;
+	TileMaker threadedTiling(gds, threaded);
+	require(sameStore(tiling.cellStore(), threadedTiling.cellStore()),
+		"4 threads give the cells of 1 thread");
+
+	TileMakerOptions tested = serial;
+	tested.analyticCrossings = !serial.analyticCrossings;
+	TileMaker testedTiling(gds, tested);
+	require(sameStore(tiling.cellStore(), testedTiling.cellStore()),
+		"analytic and tested crossings give the same cells");
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// A tiling saved to a cache directory is mapped back, cell for cell
+// and wire for wire, by the next TileMaker of the same geometry and
+// options.  Another geometry or other options build their own tiling,
+// and a truncated or corrupted file is rebuilt, not read.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+#include "WCPTiling/TilingCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace WCP;
+
+// The stores and indices of two tilings hold the same values.
+static void requireSame(const TileMaker& tiling1, const TileMaker& tiling2)
+{
+    const CellStore& store1 = tiling1.cellStore();
+    const CellStore& store2 = tiling2.cellStore();
+    require(store1.size() == store2.size(), "both tilings have as many cells");
+    for (int cell = 0; cell < store1.size(); ++cell) {
+	require(store1.uindex(cell) == store2.uindex(cell) && store1.vindex(cell) == store2.vindex(cell)
+		&& store1.yindex(cell) == store2.yindex(cell), "each cell has the same wires");
+	require(store1.nvertices(cell) == store2.nvertices(cell), "each cell has as many vertices");
+	for (int ind = 0; ind < store1.nvertices(cell); ++ind) {
+	    require(store1.vertexZ(cell,ind) == store2.vertexZ(cell,ind)
+		    && store1.vertexY(cell,ind) == store2.vertexY(cell,ind), "each vertex is the same");
+	}
+	require(store1.centerZ(cell) == store2.centerZ(cell) && store1.centerY(cell) == store2.centerY(cell)
+		&& store1.area(cell) == store2.area(cell), "each cell has the same center and area");
+    }
+
+    const CellWireIndex& index1 = tiling1.cellWireIndex();
+    const CellWireIndex& index2 = tiling2.cellWireIndex();
+    require(index1.ncells() == index2.ncells() && index1.nwires() == index2.nwires(),
+	    "both indices have as many cells and wires");
+    for (int cell = 0; cell < index1.ncells(); ++cell) {
+	require(std::equal(index1.cellWires(cell), index1.cellWires(cell)+3, index2.cellWires(cell)),
+		"each cell has the same wire numbers");
+    }
+    for (int wire = 0; wire < index1.nwires(); ++wire) {
+	require(index1.ncells(wire) == index2.ncells(wire)
+		&& std::equal(index1.cellsBegin(wire), index1.cellsEnd(wire), index2.cellsBegin(wire)),
+		"each wire forms the same cells");
+    }
+}
+
+static long fileSize(const std::string& path)
+{
+    std::FILE* fp = std::fopen(path.c_str(), "rb");
+    require(fp != 0, "the cache file exists");
+    std::fseek(fp, 0, SEEK_END);
+    const long size = std::ftell(fp);
+    std::fclose(fp);
+    return size;
+}
+
+int main()
+{
+    char directory[] = "/tmp/test_tilingcacheXXXXXX";
+    require(mkdtemp(directory) != 0, "a cache directory is made");
+
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 100, 60.0*units::degree, 3.0*units::mm, 150.0*units::mm);
+    TileMakerOptions exact, cached;
+    exact.periodicity = false;
+    cached = exact;
+    cached.cacheDirectory = directory;
+    const TileMaker built(gds, exact);
+    GeomDataSource other;
+    const std::string path = TilingCache::filename(directory, TilingCache::fingerprint(gds));
+
+    // The first tiling is built and saved, the next one mapped
+    {
+	const TileMaker saved(gds, cached);
+	require(!saved.fromCache(), "an empty directory has no tiling to map");
+	requireSame(saved, built);
+	const TileMaker mapped(gds, cached);
+	require(mapped.fromCache(), "the saved tiling is mapped");
+	requireSame(mapped, built);
+    }
+
+    // Other options and another geometry do not use the saved file
+    {
+	TileMakerOptions periodic = cached;
+	periodic.periodicity = true;
+	const TileMaker copied(gds, periodic);
+	require(!copied.fromCache(), "a periodic tiling is not mapped from an exact one");
+	require(copied.cellStore().size() == built.cellStore().size(), "the periodic tiling is built");
+
+	makeSyntheticGeometry(other, 100, 60.0*units::degree, 4.0*units::mm, 150.0*units::mm);
+	const TileMaker rebuilt(other, cached);
+	require(!rebuilt.fromCache(), "another geometry is not mapped from this one's file");
+	requireSame(rebuilt, TileMaker(other, exact));
+    }
+
+    // A truncated file is rebuilt and saved again whole
+    const long size = fileSize(path);
+    require(truncate(path.c_str(), size/2) == 0, "the cache file is truncated");
+    {
+	const TileMaker truncated(gds, cached);
+	require(!truncated.fromCache(), "a truncated file is not mapped");
+	requireSame(truncated, built);
+	require(fileSize(path) == size, "the rebuilt tiling is saved again");
+	require(TileMaker(gds, cached).fromCache(), "the saved again tiling is mapped");
+    }
+
+    // So is a whole file whose first cell's vertices do not start at
+    // zero, which follows the header and the offsets' count
+    {
+	std::FILE* fp = std::fopen(path.c_str(), "r+b");
+	require(fp != 0, "the cache file is opened");
+	const int offset = 1;
+	std::fseek(fp, sizeof(TilingCacheHeader) + sizeof(uint64_t), SEEK_SET);
+	require(std::fwrite(&offset, sizeof(offset), 1, fp) == 1, "the first offset is overwritten");
+	std::fclose(fp);
+	const TileMaker corrupted(gds, cached);
+	require(!corrupted.fromCache(), "a file with bad offsets is not mapped");
+	requireSame(corrupted, built);
+    }
+
+    std::remove(path.c_str());
+    std::remove(TilingCache::filename(directory, TilingCache::fingerprint(gds, 1)).c_str());
+    std::remove(TilingCache::filename(directory, TilingCache::fingerprint(other)).c_str());
+    rmdir(directory);
+    return 0;
+}
@@ -0,0 +1,140 @@
+// The cells a segment crosses cover it: their lengths sum to the
+// length of the segment inside the tiling, each stretch lies in its
+// cell, and each cell touches the one before.  Batched traversal
+// agrees with traversing one segment at a time.
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+
+#include <algorithm>
+
+using namespace WCP;
+
+// Traverse the segment and check the cells cover its given length
+// inside the tiling.
+static void checkSegment(const TileMaker& tiling, double Y1, double Z1, double Y2, double Z2,
+			 double inside)
+{
+    std::vector<CellCrossing> crossed;
+    const size_t num = tiling.traverse(Y1, Z1, Y2, Z2, crossed);
+    require(num == crossed.size(), "traverse returns the number of cells appended");
+
+    const CellGraph& graph = tiling.cellGraph();
+    const double length = std::sqrt((Y2-Y1)*(Y2-Y1) + (Z2-Z1)*(Z2-Z1));
+    double total = 0.0;
+    for (size_t ind = 0; ind < crossed.size(); ++ind) {
+	require(crossed[ind].length > 0.0, "every stretch has a length");
+	total += crossed[ind].length;
+	if (ind > 0) {
+	    const int* begin = graph.neighborsBegin(crossed[ind-1].cell);
+	    const int* end = graph.neighborsEnd(crossed[ind-1].cell);
+	    require(std::binary_search(begin, end, crossed[ind].cell), "each cell touches the one before");
+	}
+    }
+    require(std::fabs(total - inside) < 1e-9*length + 1e-6*units::mm*(crossed.size()+1),
+	    "the lengths sum to the length inside the tiling");
+
+    // The middle of each stretch along a segment starting inside
+    // locates to its cell
+    if (inside == length) {
+	double along = 0.0;
+	for (size_t ind = 0; ind < crossed.size(); ++ind) {
+	    const double middle = (along + 0.5*crossed[ind].length)/length;
+	    along += crossed[ind].length;
+	    if (crossed[ind].length < 1e-3*units::mm) {
+		continue;
+	    }
+	    require(tiling.locate(Y1 + middle*(Y2-Y1), Z1 + middle*(Z2-Z1)) == crossed[ind].cell,
+		    "each stretch lies in its cell");
+	}
+    }
+}
+
+static void testTiling(double angle)
+{
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 100, angle*units::degree, 3.0*units::mm, 150.0*units::mm);
+    TileMaker tiling(gds);
+    const CellStore& store = tiling.cellStore();
+
+    double minY = store.vertexY(0,0), maxY = minY, minZ = store.vertexZ(0,0), maxZ = minZ;
+    for (int cell = 0; cell < store.size(); ++cell) {
+	for (int ind = 0; ind < store.nvertices(cell); ++ind) {
+	    minY = std::min(minY, store.vertexY(cell,ind));
+	    maxY = std::max(maxY, store.vertexY(cell,ind));
+	    minZ = std::min(minZ, store.vertexZ(cell,ind));
+	    maxZ = std::max(maxZ, store.vertexZ(cell,ind));
+	}
+    }
+
+    // Segments inside the tiling, of all lengths and directions,
+    // including along a strip edge and through a cell's corner
+    std::vector<double> Y1, Z1, Y2, Z2;
+    unsigned int seed = 5;
+    for (int ind = 0; ind < 200; ++ind) {
+	double point[4];
+	for (int coord = 0; coord < 4; ++coord) {
+	    seed = 1664525*seed + 1013904223;
+	    point[coord] = ((seed >> 8) & 0xffff)/65535.0;
+	}
+	const double scale = ind % 4 == 0 ? 1.0 : 0.05;
+	Y1.push_back(minY + 1.0*units::mm + point[0]*(maxY - minY - 2.0*units::mm));
+	Z1.push_back(minZ + 1.0*units::mm + point[1]*(maxZ - minZ - 2.0*units::mm));
+	Y2.push_back(std::min(maxY, std::max(minY, Y1.back() + scale*(point[2] - 0.5)*(maxY - minY))));
+	Z2.push_back(std::min(maxZ, std::max(minZ, Z1.back() + scale*(point[3] - 0.5)*(maxZ - minZ))));
+    }
+    const int corner = tiling.locate(0.5*(minY + maxY), 0.5*(minZ + maxZ));
+    require(corner >= 0, "the middle of the tiling is in a cell");
+    Y1.push_back(store.vertexY(corner,0) - 7.0*units::mm);
+    Z1.push_back(store.vertexZ(corner,0) - 3.0*units::mm);
+    Y2.push_back(store.vertexY(corner,0) + 7.0*units::mm);
+    Z2.push_back(store.vertexZ(corner,0) + 3.0*units::mm);
+    Y1.push_back(0.5*(minY + maxY));
+    Z1.push_back(minZ);
+    Y2.push_back(0.5*(minY + maxY));
+    Z2.push_back(maxZ);
+    for (size_t ind = 0; ind < Y1.size(); ++ind) {
+	const double length = std::sqrt((Y2[ind]-Y1[ind])*(Y2[ind]-Y1[ind]) + (Z2[ind]-Z1[ind])*(Z2[ind]-Z1[ind]));
+	checkSegment(tiling, Y1[ind], Z1[ind], Y2[ind], Z2[ind], length);
+    }
+
+    // Segments reaching out of the tiling are covered inside it,
+    // and those outside or of no length cross no cell
+    const double midY = 0.5*(minY + maxY), away = 10.0*units::mm;
+    checkSegment(tiling, midY, minZ - away, midY, maxZ + away, maxZ - minZ);
+    checkSegment(tiling, maxY + away, minZ, maxY + away, maxZ, 0.0);
+    checkSegment(tiling, midY, minZ - 2*away, midY, minZ - away, 0.0);
+    checkSegment(tiling, midY, maxZ - away, midY, maxZ - away, 0.0);
+    Y1.push_back(midY);
+    Z1.push_back(minZ - away);
+    Y2.push_back(midY);
+    Z2.push_back(maxZ + away);
+    Y1.push_back(maxY + away);
+    Z1.push_back(minZ);
+    Y2.push_back(maxY + away);
+    Z2.push_back(maxZ);
+
+    std::vector<CellCrossing> batched;
+    std::vector<size_t> offsets(Y1.size()+1);
+    tiling.traverse(Y1.size(), Y1.data(), Z1.data(), Y2.data(), Z2.data(), batched, offsets.data());
+    require(offsets.front() == 0 && offsets.back() == batched.size(), "the offsets span the cells");
+    for (size_t ind = 0; ind < Y1.size(); ++ind) {
+	std::vector<CellCrossing> single;
+	tiling.traverse(Y1[ind], Z1[ind], Y2[ind], Z2[ind], single);
+	require(offsets[ind+1] - offsets[ind] == single.size(), "batched traverse crosses as many cells");
+	for (size_t at = 0; at < single.size(); ++at) {
+	    require(batched[offsets[ind]+at].cell == single[at].cell
+		    && batched[offsets[ind]+at].length == single[at].length,
+		    "batched traverse agrees with traverse");
+	}
+    }
+}
+
+int main()
+{
+    testTiling(60.0);
+    testTiling(45.0);
+    testTiling(35.7);
+    return 0;
+}
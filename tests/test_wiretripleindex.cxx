@@ -0,0 +1,106 @@
+// Wire triples find their cell, the first cell wins a repeated
+// triple and a triple forming no cell finds none, both through the
+// index itself and through TileMaker::cellID() and cell().
+
+#include "TilingTestGeometry.h"
+
+#include "WCPTiling/TileMaker.h"
+#include "WCPTiling/WireTripleIndex.h"
+
+#include <map>
+#include <tuple>
+
+using namespace WCP;
+
+static void testIndex()
+{
+    // Cells 0 and 2 share a triple
+    CellStore store;
+    const std::pair<double,double> vertices[3] = {{0.0, 0.0}, {1.0, 0.0}, {0.0, 1.0}};
+    const std::pair<double,double> center(0.3, 0.3);
+    store.add(vertices, 3, center, 0.5, 1, 2, 3);
+    store.add(vertices, 3, center, 0.5, -1, 5, 0);
+    store.add(vertices, 3, center, 0.5, 1, 2, 3);
+    store.add(vertices, 3, center, 0.5, 4, 4, 4);
+
+    WireTripleIndex triples;
+    triples.build(store);
+    require(triples.find(1, 2, 3) == 0, "first cell wins a repeated triple");
+    require(triples.find(-1, 5, 0) == 1, "a corner cell with a negative index is found");
+    require(triples.find(4, 4, 4) == 3, "the last cell is found");
+    require(triples.find(3, 2, 1) == -1, "a triple of no cell finds none");
+    require(triples.find(1<<30, 0, 0) == -1, "a triple which does not pack finds none");
+
+    const int uindex[5] = {1, -1, 4, 3, 1<<30};
+    const int vindex[5] = {2, 5, 4, 2, 0};
+    const int yindex[5] = {3, 0, 4, 1, 0};
+    int cells[5];
+    triples.find(5, uindex, vindex, yindex, cells);
+    for (int ind = 0; ind < 5; ++ind) {
+	require(cells[ind] == triples.find(uindex[ind], vindex[ind], yindex[ind]),
+		"batched find agrees with find");
+    }
+
+    WireTripleIndex empty;
+    require(empty.find(1, 2, 3) == -1, "an unbuilt index finds nothing");
+}
+
+static void testTiling(double angle)
+{
+    GeomDataSource gds;
+    makeSyntheticGeometry(gds, 100, angle*units::degree, 3.0*units::mm, 150.0*units::mm);
+    TileMaker tiling(gds);
+    const CellStore& store = tiling.cellStore();
+
+    std::map<std::tuple<int,int,int>, int> first;
+    for (int cell = 0; cell < store.size(); ++cell) {
+	first.insert(std::make_pair(std::make_tuple(store.uindex(cell), store.vindex(cell), store.yindex(cell)), cell));
+    }
+
+    std::vector<int> uindex, vindex, yindex;
+    for (int cell = 0; cell < store.size(); ++cell) {
+	const int expected = first[std::make_tuple(store.uindex(cell), store.vindex(cell), store.yindex(cell))];
+	require(tiling.cellID(store.uindex(cell), store.vindex(cell), store.yindex(cell)) == expected,
+		"cellID finds the first cell of each triple");
+	uindex.push_back(store.uindex(cell));
+	vindex.push_back(store.vindex(cell));
+	yindex.push_back(store.yindex(cell));
+
+	const GeomCell* geomcell = tiling.geomCell(cell);
+	require(geomcell != 0, "every cell has a GeomCell");
+	const GeomWireSelection wires = tiling.wires(*geomcell);
+	if (wires.size() == 3) {
+	    require(tiling.cell(wires) == tiling.geomCell(expected), "cell(wires) round trips");
+	}
+    }
+    std::vector<int> ids(store.size());
+    tiling.cellIDs(store.size(), uindex.data(), vindex.data(), yindex.data(), ids.data());
+    for (int cell = 0; cell < store.size(); ++cell) {
+	require(ids[cell] == tiling.cellID(uindex[cell], vindex[cell], yindex[cell]),
+		"batched cellIDs agrees with cellID");
+    }
+
+    // Wires far apart form no cell
+    const GeomWireSelection Uwires = gds.wires_in_plane(kUwire);
+    const GeomWireSelection Vwires = gds.wires_in_plane(kVwire);
+    const GeomWireSelection Ywires = gds.wires_in_plane(kYwire);
+    require(tiling.cellID(0, 0, Ywires.size()-1) == -1, "a triple of no cell has no ID");
+    require(tiling.cellID(0, 0, -5) == -1, "a triple outside the planes has no ID");
+    GeomWireSelection apart;
+    apart.push_back(Uwires.front());
+    apart.push_back(Vwires.front());
+    apart.push_back(Ywires.back());
+    require(tiling.cell(apart) == 0, "wires forming no cell give no cell");
+    apart.pop_back();
+    require(tiling.cell(apart) == 0, "two wires give no cell");
+    require(tiling.geomCell(-1) == 0 && tiling.geomCell(store.size()) == 0, "bad IDs give no GeomCell");
+}
+
+int main()
+{
+    testIndex();
+    testTiling(60.0);
+    testTiling(45.0);
+    testTiling(35.7);
+    return 0;
+}